@@ -0,0 +1 @@
+cmake --build build -j && build/bass -f $1 --bench 600 --no-block-cache && build/bass -f $1 --bench 600 && build/bass -f $1 --bench 600 --jit && build/bass --microbench
@@ -5,6 +5,7 @@
 #include "core/dma.hpp"
 #include "core/pak.hpp"
 #include "core/ppu.hpp"
+#include "sched/sched.hpp"
 #include "timer.hpp"
 
 struct AGB {
@@ -14,6 +15,8 @@ struct AGB {
   Pak pak      = {};
   APU apu      = {};
 
+  Scheduler scheduler = {};
+
   // Stopwatch stopwatch;
 
   std::array<std::shared_ptr<DMAContext>, 4> dma_channels;
@@ -22,12 +25,18 @@ struct AGB {
   std::atomic<bool> active = true;
 
   AGB();
+
+  // Start the cartridge with the state the BIOS leaves behind after the intro, or run the BIOS from reset.
+  // Either one goes after the ROM is loaded.
+  void direct_boot();
+  void bios_boot();
   // ~AGB();
 
-  void check_for_dma() const;
-  void tick_timers(u64 cycles);
+  void check_for_dma();
+  void trigger_dma(DMA_START_TIMING timing) const;
+  void check_halt();
+  void schedule_ppu_events();
   void system_loop();
+  void run_slice();
   void step();
-
-  bool start_timing_cond_met(DMAContext* ch) const;
 };
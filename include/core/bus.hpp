@@ -15,11 +15,13 @@ struct PPU;
 struct DMAContext;
 #include "dma.hpp"
 struct ARM7TDMI;
+struct Scheduler;
 
 inline u64 cycles_elapsed;
 
 enum class ACCESS_TYPE { SEQUENTIAL, NON_SEQUENTIAL };
 enum class WAITSTATE { WS0, WS1, WS2 };
+enum class ACCESS_WIDTH : u8 { BYTE, HALFWORD, WORD };
 struct Bus {
   enum class REGION : u8 {
     BIOS           = 0x0,
@@ -51,17 +53,24 @@ struct Bus {
   std::vector<u8> WAVE_RAM;
   std::vector<Transaction> transactions;
 
-  u32 bios_open_bus = 0;
-
-  Bus() : BIOS(0x4000), IWRAM(0x8000), EWRAM(0x40000), OAM(0x400), WAVE_RAM(0x20) {
-    if (!std::filesystem::exists("./roms/magic.bin")) {
-      spdlog::error("Running this emulator requires a valid GBA BIOS. Rename your BIOS to magic.bin, and place it in the roms/ folder.");
-      assert(0);
+  u32 bios_open_bus  = 0;
+  bool has_bios      = false;  // roms/magic.bin got loaded, otherwise BIOS holds load_builtin_bios()
+  bool dma_requested = false;  // a channel got enabled, the cpu breaks out of its batch so it can be serviced
+  u64 volatile_reads = 0;      // reads of values that move without an event (timer counters), idle loops can't be skipped over them
+
+  Bus() : BIOS(0x4000), IWRAM(0x8000), EWRAM(0x40000), OAM(0x400), WAVE_RAM(0x20), read_pages(PAGE_COUNT), write_pages(PAGE_COUNT) {
+    if (std::filesystem::exists("./roms/magic.bin")) {
+      BIOS     = read_file("roms/magic.bin");
+      has_bios = true;
+    } else {
+      spdlog::warn("no BIOS at roms/magic.bin, BIOS calls will be emulated. Rename your BIOS to magic.bin and place it in the roms/ folder to use it.");
+      load_builtin_bios();
     }
 
-    BIOS = read_file("roms/magic.bin");
     bus_logger->set_level(spdlog::level::debug);
     mem_logger->set_level(spdlog::level::debug);
+
+    rebuild_cycle_table();
   }
 
   std::shared_ptr<spdlog::logger> bus_logger = spdlog::stdout_color_mt("BUS");
@@ -73,16 +82,15 @@ struct Bus {
   PPU* ppu      = nullptr;
   std::shared_ptr<DMAContext> ch0, ch1, ch2, ch3;
   Timer *tm0, *tm1, *tm2, *tm3 = nullptr;
-  std::array<Timer, 4>* timers;
-  APU* apu = nullptr;
+  APU* apu             = nullptr;
+  Scheduler* scheduler = nullptr;
 
-  void tick_timers(u64 cycles) {
-    for (Timer& t : *timers) {
-      t.tick(cycles);
-    }
-  }
   void request_interrupt(INTERRUPT_TYPE type);
 
+  // Exception vectors and the irq dispatcher of the real BIOS, SWIs return straight away. Enough to run
+  // a cartridge from direct boot with the BIOS calls handled by the cpu's HLE.
+  void load_builtin_bios();
+
   [[nodiscard]] u8 read8(u32 address, ACCESS_TYPE access_type = ACCESS_TYPE::NON_SEQUENTIAL);
   [[nodiscard]] u16 read16(u32 address, ACCESS_TYPE access_type = ACCESS_TYPE::NON_SEQUENTIAL);
   [[nodiscard]] u32 read32(u32 address, ACCESS_TYPE access_type = ACCESS_TYPE::NON_SEQUENTIAL);
@@ -94,8 +102,73 @@ struct Bus {
   [[nodiscard]] u8 io_read(u32 address);
   void io_write(u32 address, u8 value);
 
-  u8 get_rom_cycles_by_waitstate(ACCESS_TYPE access_type, WAITSTATE ws);
-  u8 get_wram_waitstates();
+  // [region (0x10 = anything past the 28 bit bus)][width][ACCESS_TYPE]
+  std::array<std::array<std::array<u8, 2>, 3>, 0x11> access_cycles = {};
+
+  void rebuild_cycle_table();
+
+  [[nodiscard]] u8 get_access_cycles(u32 address, ACCESS_WIDTH width, ACCESS_TYPE access_type) const {
+    return access_cycles[std::min<u32>(address >> 24, 0x10)][static_cast<u8>(width)][static_cast<u8>(access_type)];
+  }
+
+  // ======= fastmem =======
+  // Host pointers for every 16 KiB page of the 28 bit address space. Plain memory is a single lookup + masked
+  // load/store, pages without a pointer (IO, SRAM/Flash, EEPROM, open bus) go through the region handlers.
+  static constexpr u32 PAGE_SHIFT = 14;
+  static constexpr u32 PAGE_SIZE  = 1 << PAGE_SHIFT;
+  static constexpr u32 PAGE_COUNT = 0x10000000 >> PAGE_SHIFT;
+
+  enum PAGE_FLAGS : u8 {
+    PAGE_SIDE_EFFECTS   = 1 << 0,  // writes have to mark ppu state dirty
+    PAGE_NO_BYTE_WRITES = 1 << 1,  // 8 bit writes are special cased (VRAM/palette/OAM), take the slow path
+    PAGE_CODE           = 1 << 2,  // IWRAM/EWRAM, writes bump the code page generation
+  };
+
+  struct FastmemPage {
+    u8* ptr  = nullptr;
+    u32 mask = 0;  // offset mask into ptr, smaller than the page for regions mirrored within a page (OAM/palette)
+    u8 flags = 0;
+  };
+
+  std::vector<FastmemPage> read_pages;
+  std::vector<FastmemPage> write_pages;
+
+  void map_fastmem_pages();
+  void map_fastmem_region(u32 base, u32 end, u8* memory, u32 size, bool readable, bool writable, u8 flags = 0);
+  void set_bios_readable(bool readable);
+  void handle_write_side_effects(u32 address);
+
+  [[nodiscard]] const FastmemPage* get_read_page(u32 address) const {
+    u32 idx = address >> PAGE_SHIFT;
+    if (idx >= PAGE_COUNT || read_pages[idx].ptr == nullptr) return nullptr;
+    return &read_pages[idx];
+  }
+
+  [[nodiscard]] const FastmemPage* get_write_page(u32 address) const {
+    u32 idx = address >> PAGE_SHIFT;
+    if (idx >= PAGE_COUNT || write_pages[idx].ptr == nullptr) return nullptr;
+    return &write_pages[idx];
+  }
+
+  // ======= code invalidation =======
+  // Every write to IWRAM/EWRAM bumps the generation of the 256 byte page it lands in. The cpu block cache
+  // keeps the generation a block was decoded at, and throws the block away once it doesn't match anymore.
+  static constexpr u32 CODE_PAGE_SHIFT = 8;
+  static constexpr u32 CODE_PAGE_COUNT = (0x40000 + 0x8000) >> CODE_PAGE_SHIFT;
+  static constexpr u32 NO_CODE_PAGE    = 0xFFFFFFFF;
+
+  std::array<u32, CODE_PAGE_COUNT> code_page_generation = {};
+
+  // EWRAM pages first, IWRAM after. anything else can't be written to, and isn't tracked
+  [[nodiscard]] static u32 get_code_page(u32 address) {
+    switch (static_cast<REGION>(address >> 24)) {
+      case REGION::EWRAM: return (address & 0x3FFFF) >> CODE_PAGE_SHIFT;
+      case REGION::IWRAM: return (0x40000 + (address & 0x7FFF)) >> CODE_PAGE_SHIFT;
+      default: return NO_CODE_PAGE;
+    }
+  }
+
+  void note_code_write(u32 address) { code_page_generation[get_code_page(address)]++; }
 
   enum MAPPING_MODE : u8 { ONE_DIMENSIONAL = 1, TWO_DIMENSIONAL = 0 };
 
@@ -189,7 +262,7 @@ struct Bus {
         u8 wait_control_wram : 4;
         u8                   : 4;
       };
-      u32 IMC;
+      u32 IMC = 0x0D000020;  // EWRAM 2 waitstates
     };
   } system_control = {};
 
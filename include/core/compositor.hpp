@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+
+#include "common/defs.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define BASS_COMPOSITOR_X64 1
+#else
+#define BASS_COMPOSITOR_X64 0
+#endif
+
+// Layers in the order they win a priority tie: OBJ above BG0 above BG3, the backdrop below everything.
+enum LAYER : u8 { LAYER_OBJ, LAYER_BG0, LAYER_BG1, LAYER_BG2, LAYER_BG3, LAYER_BACKDROP, LAYER_NONE = 7 };
+
+static constexpr u32 LINE_WIDTH = 240;
+
+// Layer colours are the BGR555 value, with the palette RAM entry it came from (0-511) in the upper half, or
+// DIRECT_COLOR set for the 16 bit pixels of bitmap modes 3 and 5. Blending needs the 5 bit channels and the
+// entry, they only become host colours once the line is blended.
+static constexpr u32 DIRECT_COLOR        = 1u << 15;
+static constexpr u32 PALETTE_ENTRY_SHIFT = 16;
+
+// One line of one layer, struct of arrays so a kernel loads the same field of 4/8 pixels at once.
+// opaque is 0xFF or 0, prio is only looked at where opaque is set.
+struct LayerLine {
+  std::array<u32, LINE_WIDTH> color = {};
+  std::array<u8, LINE_WIDTH> prio   = {};
+  std::array<u8, LINE_WIDTH> opaque = {};
+};
+
+// The two front-most layers of every pixel of a line. The backdrop is always one of them when fewer than two
+// layers are opaque, bottom is LAYER_NONE (colour = backdrop) when nothing but the backdrop is.
+struct CompositeLine {
+  std::array<u32, LINE_WIDTH> top_color    = {};
+  std::array<u32, LINE_WIDTH> bottom_color = {};
+  std::array<u8, LINE_WIDTH> top_layer     = {};
+  std::array<u8, LINE_WIDTH> bottom_layer  = {};
+};
+
+using LayerLines = std::array<LayerLine, LAYER_BACKDROP>;
+
+// Resolves the top two of layers[ids[0..count)] plus the backdrop for every pixel. Every kernel gives the
+// exact same result, a pixel's sort key is (prio << 3) | layer and the lowest two win.
+using CompositeKernel = void (*)(const LayerLines& layers, const u8* ids, u32 count, u32 backdrop, CompositeLine& out);
+
+enum BLEND_EFFECT : u8 { EFFECT_NONE, EFFECT_ALPHA, EFFECT_BRIGHTEN, EFFECT_DARKEN };
+
+// What the blend kernels turn layer colours into host colours with. rgb is the BGR555 -> host colour table,
+// brighter/darker hold the host colour of every palette entry with the BLDY fade applied. Direct colours have
+// no entry, they get faded by evy on the spot.
+struct BlendTables {
+  const u32* rgb      = nullptr;
+  const u32* brighter = nullptr;
+  const u32* darker   = nullptr;
+  u32 evy             = 0;
+};
+
+// Writes the host colour of every pixel of a composited line: effect[x] picks top as is, top and bottom
+// alpha blended with eva/evb, or the faded top. Everything is done on 5 bit channels like the hardware does,
+// the coefficients are already clamped to 16.
+using BlendKernel = void (*)(const CompositeLine& line, const u8* effect, const BlendTables& tables, u32 eva, u32 evb, u32* out);
+
+// BLDY brightness on a BGR555 colour, per 5 bit channel: I + (31 - I) * EVY / 16 up, I - I * EVY / 16 down
+u16 adjust_brightness(u16 color, u32 evy, bool increase);
+
+enum struct COMPOSITOR : u8 { SCALAR, SSE41, AVX2 };
+
+// the widest kernel the host supports, checked with CPUID once
+COMPOSITOR best_compositor();
+bool compositor_supported(COMPOSITOR);
+CompositeKernel get_composite_kernel(COMPOSITOR);
+BlendKernel get_blend_kernel(COMPOSITOR);
+const char* compositor_name(COMPOSITOR);
@@ -2,52 +2,24 @@
 
 #include <spdlog/logger.h>
 
+#include <bit>
+#include <bitset>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "bus.hpp"
 #include "capstone/capstone.h"
 #include "common/defs.hpp"
 #include "instructions/arm.hpp"
+#include "jit.hpp"
 #include "registers.hpp"
 #include "spdlog/sinks/stdout_color_sinks.h"
 
 typedef void (*FuncPtr)(ARM7TDMI*, u32);
-
-enum struct ALU_OP : u8 {
-  AND = 0x0,
-  EOR = 0x1,
-  SUB = 0x2,
-  RSB = 0x3,
-  ADD = 0x4,
-  ADC = 0x5,
-  SBC = 0x6,
-  RSC = 0x7,
-  TST = 0x8,
-  TEQ = 0x9,
-  CMP = 0xA,
-  CMN = 0xB,
-  ORR = 0xC,
-  MOV = 0xD,
-  BIC = 0xE,
-  MVN = 0xF,
-};
-
-enum struct THUMB_ALU_OP : u8 {
-  AND = 0x0,
-  EOR = 0x1,
-  LSL = 0x2,
-  LSR = 0x3,
-  ASR = 0x4,
-  ADC = 0x5,
-  SBC = 0x6,
-  ROR = 0x7,
-  TST = 0x8,
-  NEG = 0x9,
-  CMP = 0xA,
-  CMN = 0xB,
-  ORR = 0xC,
-  MUL = 0xD,
-  BIC = 0xE,
-  MVN = 0xF,
-};
+typedef u32 (*NativeBlock)(ARM7TDMI*, u64 target_cycle);  // returns the amount of instructions executed
+typedef void (*NativeInstr)(ARM7TDMI*);
 
 static constexpr u32 IRQ_VECTOR = 0x18;
 
@@ -74,7 +46,7 @@ struct ARM7TDMI {
 
   std::shared_ptr<spdlog::logger> cpu_logger = spdlog::stdout_color_mt("ARM7TDMI");
 
-  constexpr FuncPtr arm_decode(u32 shifted_opcode) {
+  static constexpr FuncPtr arm_decode(u32 shifted_opcode) {
     if ((shifted_opcode & 0xfcf) == 0x9) {
       return ARM_MULTIPLY;
     }
@@ -143,7 +115,7 @@ struct ARM7TDMI {
     return nullptr;
   };
 
-  constexpr FuncPtr thumb_decode(u16 opcode) {
+  static constexpr FuncPtr thumb_decode(u16 opcode) {
     if ((opcode & 0b1111100000) == 0b0001100000) {  // ADD, SUB
       return THUMB_ADD_SUB;
     }
@@ -242,13 +214,135 @@ struct ARM7TDMI {
 
   void flush_pipeline();
   u64 cycles_this_step;
+  bool halted = false;  // set through HALTCNT, cleared by the system loop once IE & IF != 0
   u64 step();
 
+  // Executes instructions back to back until target_cycle is reached, or something the
+  // system loop has to handle (DMA request, halt) comes up. Returns early, never overshoots by more than 1 instruction.
+  void run_until(u64 target_cycle);
+  template <CPU_MODE state>
+  void run_interpreter(u64 target_cycle);
+
+  // ======= block cache =======
+  // Straight line runs of instructions, decoded once and replayed without going through the bus and the
+  // decode tables again. Handlers still extract their own operands, a block stores what the table lookup
+  // and condition decode would have produced for each opcode.
+  static constexpr u8 MAX_BLOCK_LENGTH = 32;
+
+  struct CachedInstr {
+    FuncPtr handler = nullptr;
+    u32 opcode      = 0;
+    Condition cond  = AL;
+  };
+
+  struct Block {
+    u32 start       = 0;
+    CPU_MODE state  = ARM_MODE;
+    u8 length       = 0;  // instructions executed from the block, 0 if the first one can't be decoded
+    u8 opcode_count = 0;  // length + up to 2 opcodes the pipeline prefetches past the end, if on the same code page
+    u32 code_page   = Bus::NO_CODE_PAGE;
+    u32 generation  = 0;  // code page generation at decode time, IWRAM/EWRAM only
+
+    std::array<CachedInstr, MAX_BLOCK_LENGTH + 2> instrs = {};
+
+    // x86-64 translation, dropped along with the rest whenever the block gets recompiled
+    NativeBlock native = nullptr;
+    u32 native_epoch   = 0;  // JIT::epoch the code was emitted in
+    u8 native_length   = 0;  // instructions covered, blocks cut short by the end of a page leave the tail to run_block()
+    u16 run_count      = 0;
+
+    bool idle_loop = false;  // branches back to its own start without side effects, see check_idle_loop()
+  };
+
+  bool use_block_cache      = true;
+  u64 instructions_executed = 0;
+
+  std::unordered_map<u32, Block> block_cache;
+
+  // block starting at the instruction about to be executed, nullptr if the region isn't cacheable
+  Block* get_block();
+  void compile_block(Block& block, u32 address, CPU_MODE state);
+  u32 run_block(const Block& block, u64 target_cycle);
+
+  // ======= idle loops =======
+  // Polling VCOUNT, DISPSTAT or a flag the irq handler sets. If an iteration of an idle_loop block leaves every
+  // register and flag the way the previous one did, only an event can change the outcome of the next one, so
+  // time skips to the next event the same way it does while halted.
+  static constexpr u8 MAX_IDLE_LOOP_LENGTH = 8;
+
+  struct {
+    u32 start             = 0xFFFFFFFF;  // loop the snapshot was taken at the end of, none if all 1s
+    u32 cpsr              = 0;
+    u64 volatile_reads    = 0;
+    std::array<u32, 15> r = {};
+  } idle_snapshot;
+
+  bool use_idle_skip      = true;
+  u64 idle_loops_skipped  = 0;
+  u64 idle_cycles_skipped = 0;
+
+  void check_idle_loop(const Block& block, u64 target_cycle);
+
+  // ======= BIOS HLE =======
+  // Div, Sqrt, ArcTan/ArcTan2, CpuSet, CpuFastSet, GetBiosChecksum, the affine setups, BitUnPack and the
+  // decompressors done in C++ instead of running the BIOS code for them. The caller sees the same registers and memory, and the cycles the BIOS would have taken
+  // get charged as an estimate. Halt, IntrWait and VBlankIntrWait halt the cpu. Anything else (and the cases the
+  // BIOS hangs on) still goes through the BIOS, or straight back to the caller with the built-in one (and a
+  // warning the first time).
+  // In check mode the BIOS runs every call, the HLE result is kept aside and compared once it returns.
+  bool use_hle_bios   = false;
+  bool check_hle_bios = false;
+  u64 hle_calls       = 0;
+  u64 hle_mismatches  = 0;
+  std::bitset<256> hle_unimplemented_warned = {};  // SWIs the built-in BIOS returned from, warned about once each
+
+  struct HleWrite {
+    u32 address        = 0;
+    u32 value          = 0;
+    ACCESS_WIDTH width = ACCESS_WIDTH::WORD;
+  };
+
+  struct {
+    bool pending            = false;
+    u8 number               = 0;
+    u32 return_address      = 0;
+    CPU_MODE state          = ARM_MODE;
+    BANK_MODE mode          = SYSTEM;
+    u16 reg_mask            = 0;  // r0-r3 the HLE version sets
+    std::array<u32, 4> regs = {};
+    std::vector<HleWrite> writes;
+  } hle_check;
+
+  // false if the call is left to the BIOS, always the case in check mode
+  bool hle_swi(u8 number);
+  bool hle_wait(u8 number);
+  u32 hle_wait_address = 0xFFFFFFFF;  // SWI an IntrWait is halted in, it runs again once an irq comes in
+  void hle_check_result();
+
+  // ======= recompiler =======
+  // Hot blocks get translated to x86-64. Data processing with an immediate or low register operand is emitted
+  // inline, everything else calls the same handler the interpreter would, with the pipeline and r15 synced first.
+  static constexpr u16 JIT_THRESHOLD = 16;  // block runs before it gets translated
+
+  bool use_jit = false;
+  JIT jit;
+
+  std::array<u16, 16> condition_masks = {};  // bit n set if the condition passes with NZCV == n
+
+  void jit_compile(Block& block);
+  bool jit_emit_instr(const CachedInstr& instr, CPU_MODE state);
+  NativeInstr jit_compile_instr(u32 opcode);
+  u32 run_native(Block& block, u64 target_cycle);
+  u64 step_native();
+
+  // an irq would be taken before the next instruction, blocks leave that to step()
+  [[nodiscard]] bool irq_ready() const { return !regs.CPSR.irq_disable && bus->interrupt_control.IME.enabled && interrupt_queued(); }
+
   void print_pipeline() const;
   void execute(u32 opcode);
   void handle_interrupts();
 
-  [[nodiscard]] bool check_condition(Condition i) const;
+  [[nodiscard]] bool check_condition(Condition i);
 
   void print_registers() const;
 
@@ -259,43 +353,81 @@ struct ARM7TDMI {
 
   [[nodiscard]] bool interrupt_queued() const;
 
-  void set_zero() { regs.CPSR.ZERO_FLAG = true; };
-  void reset_zero() { regs.CPSR.ZERO_FLAG = false; };
+  // single flag writes land on top of whatever is still pending
+  void set_zero() { regs.sync_flags(); regs.CPSR.ZERO_FLAG = true; };
+  void reset_zero() { regs.sync_flags(); regs.CPSR.ZERO_FLAG = false; };
 
-  void set_negative() { regs.CPSR.SIGN_FLAG = true; };
-  void reset_negative() { regs.CPSR.SIGN_FLAG = false; };
+  void set_negative() { regs.sync_flags(); regs.CPSR.SIGN_FLAG = true; };
+  void reset_negative() { regs.sync_flags(); regs.CPSR.SIGN_FLAG = false; };
 
-  void set_carry() { regs.CPSR.CARRY_FLAG = true; };
-  void reset_carry() { regs.CPSR.CARRY_FLAG = false; };
+  void set_carry() { regs.sync_flags(); regs.CPSR.CARRY_FLAG = true; };
+  void reset_carry() { regs.sync_flags(); regs.CPSR.CARRY_FLAG = false; };
 
-  void set_overflow() { regs.CPSR.OVERFLOW_FLAG = true; };
-  void reset_overflow() { regs.CPSR.OVERFLOW_FLAG = false; };
+  void set_overflow() { regs.sync_flags(); regs.CPSR.OVERFLOW_FLAG = true; };
+  void reset_overflow() { regs.sync_flags(); regs.CPSR.OVERFLOW_FLAG = false; };
 
-  [[nodiscard]] u32 handle_shifts(bool I, bool R, u8 Rm, u8 Rs, u8 shift_type, u32 imm, u8 rotate, u8 shift_amount, bool S, bool affect_flags = true);
+  [[nodiscard]] bool get_carry() {
+    regs.sync_flags();
+    return regs.CPSR.CARRY_FLAG;
+  }
 
-  u32 fetch(u32 address);
+  template <bool I, bool R, u8 shift_type, bool S, bool affects_flags>
+  [[nodiscard]] u32 handle_shifts(u8 Rm, u8 Rs, u32 imm, u8 rotate, u8 shift_amount) {
+    if constexpr (!I) {
+      if constexpr (R) {
+        u8 add_amount = Rm == 15 ? 4 : 0;  // PC reads as PC+12 (PC already reads +8) when used as shift register
+
+        return shift(static_cast<SHIFT_MODE>(shift_type), regs.get_reg(Rm) + add_amount, regs.get_reg(Rs) & 0xff, false, true, affects_flags);
+      } else {
+        return shift(static_cast<SHIFT_MODE>(shift_type), regs.get_reg(Rm), shift_amount, true, false, affects_flags);
+      }
+    } else if constexpr (S) {
+      return shift(ROR, imm, rotate * 2, false, true);
+    } else {
+      return std::rotr(imm, rotate * 2);
+    }
+  }
 
-  constexpr std::array<FuncPtr, 4096> fill_arm_func_tables() {
-    std::array<FuncPtr, 4096> arm_funcs = {};
+  u32 fetch(u32 address);
 
-    for (u32 i = 0; i < 4096; i++) {
-      arm_funcs[i] = arm_decode(i);
+  // Slot -> handler. The ALU formats get a specialization per operation (and per I/S/R/shift type on ARM),
+  // so none of that gets decoded at runtime, everything else uses what decode returned.
+  template <u16 bits>
+  static constexpr FuncPtr arm_specialize() {
+    if constexpr (arm_decode(bits) == ARM_DATA_PROCESSING) {
+      constexpr bool I        = bits & (1 << 9);
+      constexpr bool S        = bits & (1 << 4);
+      constexpr bool R        = !I && (bits & 1);  // operand 2 bits mean nothing with an immediate, keeps the copies down
+      constexpr u8 shift_type = I ? 0 : (bits >> 1) & 0b11;
+
+      return ARM_DATA_PROCESSING_T<static_cast<ALU_OP>((bits >> 5) & 0xF), I, S, R, shift_type>;
+    } else {
+      return arm_decode(bits);
     }
+  }
 
-    return arm_funcs;
-  };
-  constexpr std::array<FuncPtr, 1024> fill_thumb_func_tables() {
-    std::array<FuncPtr, 1024> thumb_funcs = {};
+  template <u16 bits>
+  static constexpr FuncPtr thumb_specialize() {
+    constexpr FuncPtr handler = thumb_decode(bits);
 
-    for (u16 i = 0; i < 1024; i++) {
-      thumb_funcs[i] = thumb_decode(i);
-    }
+    if constexpr (handler == THUMB_ADD_SUB) return THUMB_ADD_SUB_T<(bits >> 3) & 0b11>;
+    if constexpr (handler == THUMB_MOVE_SHIFTED_REG) return THUMB_MOVE_SHIFTED_REG_T<(bits >> 5) & 0b11>;
+    if constexpr (handler == THUMB_MOV_CMP_ADD_SUB) return THUMB_MOV_CMP_ADD_SUB_T<(bits >> 5) & 0b11>;
+    if constexpr (handler == THUMB_DATA_PROC) return THUMB_DATA_PROC_T<static_cast<THUMB_ALU_OP>(bits & 0xF)>;
+
+    return handler;
+  }
 
-    return thumb_funcs;
+  static constexpr std::array<FuncPtr, 4096> fill_arm_func_tables() {
+    return []<size_t... i>(std::index_sequence<i...>) { return std::array<FuncPtr, 4096>{arm_specialize<i>()...}; }(std::make_index_sequence<4096>{});
+  };
+  static constexpr std::array<FuncPtr, 1024> fill_thumb_func_tables() {
+    return []<size_t... i>(std::index_sequence<i...>) { return std::array<FuncPtr, 1024>{thumb_specialize<i>()...}; }(std::make_index_sequence<1024>{});
   };
 
-  std::array<FuncPtr, 4096> arm_funcs   = fill_arm_func_tables();
-  std::array<FuncPtr, 1024> thumb_funcs = fill_thumb_func_tables();
+  // shared by every instance, defined below once the class is complete
+  static const std::array<FuncPtr, 4096> arm_funcs;
+  static const std::array<FuncPtr, 1024> thumb_funcs;
 
   [[nodiscard]] constexpr u32 align_by_current_mode(u32 value) const {
     if (regs.CPSR.STATE_BIT == ARM_MODE) {
@@ -304,4 +436,7 @@ struct ARM7TDMI {
       return value & ~1;
     }
   }
-};
\ No newline at end of file
+};
+
+inline constexpr std::array<FuncPtr, 4096> ARM7TDMI::arm_funcs   = ARM7TDMI::fill_arm_func_tables();
+inline constexpr std::array<FuncPtr, 1024> ARM7TDMI::thumb_funcs = ARM7TDMI::fill_thumb_func_tables();
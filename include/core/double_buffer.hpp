@@ -11,5 +11,6 @@ struct DoubleBuffer {
   DoubleBuffer(u32* _write_buf, u32* _disp_buf) : write_buf(_write_buf), disp_buf(_disp_buf) {}
 
   void write(size_t idx, u32 value);
+  void write_line(size_t idx, const u32* values, size_t count);
   void swap_buffers();
 };
\ No newline at end of file
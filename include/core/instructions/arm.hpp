@@ -11,6 +11,44 @@ enum SHIFT_MODE {
   ROR,
 };
 
+enum struct ALU_OP : u8 {
+  AND = 0x0,
+  EOR = 0x1,
+  SUB = 0x2,
+  RSB = 0x3,
+  ADD = 0x4,
+  ADC = 0x5,
+  SBC = 0x6,
+  RSC = 0x7,
+  TST = 0x8,
+  TEQ = 0x9,
+  CMP = 0xA,
+  CMN = 0xB,
+  ORR = 0xC,
+  MOV = 0xD,
+  BIC = 0xE,
+  MVN = 0xF,
+};
+
+enum struct THUMB_ALU_OP : u8 {
+  AND = 0x0,
+  EOR = 0x1,
+  LSL = 0x2,
+  LSR = 0x3,
+  ASR = 0x4,
+  ADC = 0x5,
+  SBC = 0x6,
+  ROR = 0x7,
+  TST = 0x8,
+  NEG = 0x9,
+  CMP = 0xA,
+  CMN = 0xB,
+  ORR = 0xC,
+  MUL = 0xD,
+  BIC = 0xE,
+  MVN = 0xF,
+};
+
 void ARM_BRANCH_LINK(ARM7TDMI* cpu, u32 x);
 void ARM_SWAP(ARM7TDMI* cpu, u32 x);
 void ARM_HALFWORD_LOAD_STORE(ARM7TDMI* cpu, u32 x);
@@ -47,24 +85,53 @@ void THUMB_LOAD_STORE_SP_REL(ARM7TDMI* cpu, u32 opcode);
 void THUMB_PUSH_POP(ARM7TDMI* cpu, u32 offset);
 void THUMB_BLOCK_DATA_TRANSFER(ARM7TDMI* cpu, u32 offset);
 
+// Copies of the ALU formats with the decode bits baked in, what the handler tables actually point to.
+// The untemplated versions above only look the specialization up, decode uses them to identify the format.
+template <ALU_OP op, bool I, bool S, bool R, u8 shift_type>
+void ARM_DATA_PROCESSING_T(ARM7TDMI* cpu, u32 x);
+template <u8 op>
+void THUMB_ADD_SUB_T(ARM7TDMI* cpu, u32 opcode);
+template <u8 op>
+void THUMB_MOVE_SHIFTED_REG_T(ARM7TDMI* cpu, u32 opcode);
+template <u8 op>
+void THUMB_MOV_CMP_ADD_SUB_T(ARM7TDMI* cpu, u32 opcode);
+template <THUMB_ALU_OP op>
+void THUMB_DATA_PROC_T(ARM7TDMI* cpu, u32 opcode);
+
 void THUMB_LDR_REG_OFFSET(ARM7TDMI* cpu, u32 opcode);
 void THUMB_LDR_SP_REL(ARM7TDMI* cpu, u32 opcode);
 
+template <bool I, bool S, bool R, u8 shift_type>
 void AND(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void EOR(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void SUB(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void RSB(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void ADD(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void ADC(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void SBC(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void RSC(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void TST(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void TEQ(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void CMP(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void CMN(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void ORR(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void MOV(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void BIC(ARM7TDMI* cpu, u32 opcode);
+template <bool I, bool S, bool R, u8 shift_type>
 void MVN(ARM7TDMI* cpu, u32 opcode);
 
 void LDR(ARM7TDMI* c, u32 opcode, bool pc_relative = false);
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "common/defs.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BASS_JIT_X64 1
+#else
+#define BASS_JIT_X64 0
+#endif
+
+// Executable code buffer plus the handful of x86-64 encodings the recompiler needs. Nothing here knows
+// about the ARM side, see recompiler.cpp for the translation itself. Blocks are never freed one by one,
+// once the buffer runs out everything gets dropped and the epoch bumped, so stale entry points can be told apart.
+struct JIT {
+  static constexpr size_t CODE_BUFFER_SIZE    = 16 * 1024 * 1024;
+  static constexpr size_t MAX_BLOCK_CODE_SIZE = 16 * 1024;  // worst case for a MAX_BLOCK_LENGTH block is far below this
+
+  enum Reg : u8 { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+  // condition code nibble of jcc/setcc
+  enum Cond : u8 { O, NO, B, AE, E, NE, BE, A, S, NS };
+
+  // /digit of the 0x81 group, opcode of the r/m, reg form is (op << 3) | 1
+  enum AluOp : u8 { ADD, OR, ADC, SBB, AND, SUB, XOR, CMP };
+
+#ifdef _WIN32
+  static constexpr Reg ARG0 = RCX;
+  static constexpr Reg ARG1 = RDX;
+#else
+  static constexpr Reg ARG0 = RDI;
+  static constexpr Reg ARG1 = RSI;
+#endif
+
+  u8* code      = nullptr;
+  size_t offset = 0;
+  u32 epoch     = 0;  // bumped every time the buffer gets reset
+
+  JIT();
+  ~JIT();
+  JIT(const JIT&)            = delete;
+  JIT& operator=(const JIT&) = delete;
+
+  [[nodiscard]] bool available() const { return code != nullptr; }
+  [[nodiscard]] u8* cursor() const { return code + offset; }
+
+  // makes sure a whole block fits, resets the buffer if it doesn't
+  void reserve_block();
+
+  void emit8(u32 v) { code[offset++] = static_cast<u8>(v); }
+  void emit32(u32 v);
+  void emit64(u64 v);
+
+  void rex(bool w, u8 reg, u8 base, bool force = false);
+  void modrm_mem(u8 reg, Reg base, i32 disp);
+
+  void push(Reg r);
+  void pop(Reg r);
+  void ret() { emit8(0xC3); }
+  void call(const void* fn);  // through rax
+
+  void mov64(Reg dst, Reg src);
+  void mov64_imm(Reg dst, u64 imm);
+  void mov32_imm(Reg dst, u32 imm);
+  void load32(Reg dst, Reg base, i32 disp);
+  void load64(Reg dst, Reg base, i32 disp);
+  void load8_zx(Reg dst, Reg base, i32 disp);
+  void store32(Reg base, i32 disp, Reg src);
+  void store64(Reg base, i32 disp, Reg src);
+  void store32_imm(Reg base, i32 disp, u32 imm);
+  void store8_imm(Reg base, i32 disp, u8 imm);
+
+  void alu32(AluOp op, Reg dst, Reg src);
+  void alu32_imm(AluOp op, Reg dst, u32 imm);
+  void alu32_mem(AluOp op, Reg dst, Reg base, i32 disp);
+  void alu32_mem_imm(AluOp op, Reg base, i32 disp, u32 imm);
+  void alu64(AluOp op, Reg dst, Reg src);
+  void alu64_imm8(AluOp op, Reg dst, i8 imm);
+  void test32(Reg a, Reg b);
+  void not32(Reg r);
+  void shl32(Reg r, u8 amount);
+  void shr32(Reg r, u8 amount);
+  void bt32(Reg r, Reg bit);
+  void setcc(Cond c, Reg r);
+  void movzx8(Reg dst, Reg src);
+
+  // rel32 jumps, return the displacement to patch once the target is known
+  u8* jcc(Cond c);
+  u8* jmp();
+  static void patch(u8* displacement, const u8* target);
+};
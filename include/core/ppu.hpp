@@ -1,7 +1,10 @@
 #pragma once
 struct Bus;
+#include <bitset>
+
 #include "bus.hpp"
 #include "common/defs.hpp"
+#include "compositor.hpp"
 #include "double_buffer.hpp"
 #include "spdlog/logger.h"
 #include "spdlog/sinks/stdout_color_sinks.h"
@@ -12,11 +15,6 @@ enum struct OBJ_SHAPE : u8 { SQUARE, HORIZONTAL, VERTICAL, PROHIBITED };
 
 static constexpr u32 OBJ_DATA_OFFSET = 0x10000;
 
-struct Item {
-  u8 bg_id;    // primary key
-  u8 bg_prio;  // first tiebreaker
-};
-
 // An entry in a map, representing the background.
 // Imagine a 32x32 map, where each entry has the properties described below. This is makes up the LAYOUT of the background
 // Not to be confused with the **tile set**, which contains the tiles, which are USED in the Screen Entry.
@@ -35,13 +33,11 @@ union ScreenBlockEntryMode1 {
 
 using PaletteIndex    = u8;
 using Tile            = std::array<PaletteIndex, 8 * 8>;
-using TileSet         = std::array<Tile, 1024>;
-using TileMap         = std::array<ScreenBlockEntryMode0, 64 * 64>;
 using AffineTileMap   = std::array<ScreenBlockEntryMode1, 128 * 128>;
 using TransparencyMap = std::array<bool, 512 * 512>;
 
 struct PPU {
-  PPU() : VRAM(0x18000) {
+  PPU() : PALETTE_RAM(0x400), VRAM(0x18000) {
     // initialize affine frame buffers
     for (auto& arr : tile_map_affine_texture_buffer_arr) {
       arr.resize(1024 * 1024);
@@ -53,6 +49,11 @@ struct PPU {
     }
 
     backdrop.resize(512 * 512);
+
+    for (auto& dirty : tile_dirty) dirty.set();
+
+    rebuild_obj_lines();  // entries start out matching the zeroed OAM
+    for (u32 entry = 0; entry < PALETTE_ENTRIES; entry++) update_palette_entry(entry);
   }
   static constexpr u32 VRAM_BASE            = 0x06000000;
   static constexpr u32 PALETTE_RAM_BG_BASE  = 0x05000000;
@@ -69,7 +70,13 @@ struct PPU {
   struct State {  // track changes to ppu specific registers, for example the changing of the character/screen base blocks
     std::array<bool, 4> cbb_changed = {true, true, true, true};
     bool oam_changed                = true;
+    bool vram_changed               = true;
     bool mapping_mode_changed       = true;
+    bool obj_tiles_changed          = true;
+
+    std::bitset<128> oam_entry_dirty = std::bitset<128>().set();   // attr0-2 of the entry changed
+    std::bitset<32> oam_affine_dirty = std::bitset<32>().set();    // one of the 4 attr3 words of the parameter group changed
+    std::bitset<1024> obj_tile_dirty = std::bitset<1024>().set();  // OBJ tile in VRAM changed
 
   } state;
 
@@ -312,39 +319,106 @@ struct PPU {
     std::array<PaletteIndex, 64 * 64> data = {};
   };
 
-  struct PixInfo {
-    u32 color_id;
-    u32 color;
-    u8 prio;
-    bool transparent = true;
-    u8 bg_id;
-    bool active;
-    u8 oam_idx;
-  };
+  // PALETTE_RAM as layer colours (see compositor.hpp), the 256 BG entries followed by the 256 OBJ ones. The bus
+  // keeps it in sync on every palette write, so a pixel costs a single load. brighter/darker are the host colours
+  // of the same entries with the BLDY brightness increase/decrease applied. They're only kept up to date while
+  // lines fade: stale once a line doesn't (or BLDY changes), rebuilt by the next line that does.
+  static constexpr u32 PALETTE_ENTRIES    = 512;
+  static constexpr u32 PALETTE_OBJ_OFFSET = 256;
+
+  std::array<u32, PALETTE_ENTRIES> palette          = {};
+  std::array<u32, PALETTE_ENTRIES> palette_brighter = {};
+  std::array<u32, PALETTE_ENTRIES> palette_darker   = {};
+  u8 palette_evy                                    = 0;
+  bool palette_fades_stale                          = true;
+
+  void update_palette_entry(u32 entry);
+
+  // called by the bus for every palette RAM write, refreshes both entries of the (aligned) word
+  void mark_palette_dirty(u32 palette_offset) {
+    u32 entry = (palette_offset % 0x400) / 4 * 2;
+
+    update_palette_entry(entry);
+    update_palette_entry(entry + 1);
+  }
+
+  // called by the bus on BLDY writes
+  void set_brightness(u8 evy);
+  void refresh_palette_fades();
 
-  std::array<OAM_Entry, 128> entries;
+  std::array<OAM_Entry, 128> entries = {};
   std::array<OBJ, 128> objs;
+
+  // OAM indices of the sprites intersecting each visible line, in OAM order
+  std::array<std::array<u8, 128>, 160> obj_lines = {};
+  std::array<u8, 160> obj_line_count             = {};
+  std::vector<u8> PALETTE_RAM;
   std::vector<u8> VRAM;
 
   std::vector<u32> backdrop;
 
+  // full 512x512 maps of the text BGs, only drawn when the debugger asks for them (render_text_bg_texture)
   std::array<std::vector<u32>, 4> tile_map_texture_buffer_arr;
   std::array<std::vector<u32>, 4> tile_map_affine_texture_buffer_arr;
 
-  std::array<std::array<bool, 512 * 512>, 4> transparency_maps;
-  std::array<PixInfo, 512 * 512> background_layer;
-  std::array<PixInfo, 256 * 256> sprite_layer;
+  // the visible 240 pixels of a text BG on the current line. index goes straight into BG palette RAM,
+  // 4bpp tiles have their palette bank in the upper nibble
+  struct BgLine {
+    std::array<u8, SYSTEM_DISPLAY_WIDTH> index    = {};
+    std::array<bool, SYSTEM_DISPLAY_WIDTH> opaque = {};
+  };
+
+  std::array<BgLine, 4> bg_lines = {};
+
+  // 8bpp palette index of every pixel of the affine BG maps, 0 is transparent
+  std::array<std::array<u8, 512 * 512>, 4> affine_index_maps;
+
+  // what each layer has on the current line, merged by compose_scanline()
+  LayerLines layer_lines       = {};
+  CompositeLine composite_line = {};
+  CompositeKernel composite    = get_composite_kernel(best_compositor());
+  BlendKernel blend            = get_blend_kernel(best_compositor());
+
+  // per pixel of the current line, in WININ/BLDCNT bit order (BG0-3, OBJ, effects): what its window enables
+  std::array<u8, SYSTEM_DISPLAY_WIDTH> window_mask = {};
+
+  // 0xFF where an OBJ window sprite is opaque, and where the OBJ that shows is semi-transparent
+  std::array<u8, SYSTEM_DISPLAY_WIDTH> obj_window           = {};
+  std::array<u8, SYSTEM_DISPLAY_WIDTH> obj_semi_transparent = {};
+  bool line_has_semi_transparent_obj                        = false;
+
+  std::array<u8, SYSTEM_DISPLAY_WIDTH> blend_effect  = {};
+  std::array<u32, SYSTEM_DISPLAY_WIDTH> blended_line = {};
+
+  // vertical BG mosaic: the first line of the mosaic block each BG last rendered, and its opaque mask from
+  // before windows were applied. the rest of the block shows that line again instead of rendering its own
+  static constexpr u16 NO_MOSAIC_LINE = 0xFFFF;
+
+  std::array<u16, 4> mosaic_source_line                          = {NO_MOSAIC_LINE, NO_MOSAIC_LINE, NO_MOSAIC_LINE, NO_MOSAIC_LINE};
+  std::array<std::array<u8, SYSTEM_DISPLAY_WIDTH>, 4> mosaic_opaque = {};
+
+  // decoded tiles, one slot per 32 byte unit of VRAM for each colour depth (char block = unit >> 9).
+  // a slot is only re-decoded after a VRAM write lands on the bytes it was decoded from.
+  static constexpr u32 TILE_UNIT_SIZE  = 0x20;
+  static constexpr u32 TILE_UNIT_COUNT = 0x18000 / TILE_UNIT_SIZE;
+
+  std::array<std::array<Tile, TILE_UNIT_COUNT>, 2> tile_cache = {};
+  std::array<std::bitset<TILE_UNIT_COUNT>, 2> tile_dirty      = {};
 
-  std::array<TileSet, 4> tile_sets              = {};
-  std::array<TileMap, 4> tile_maps              = {};
   std::array<AffineTileMap, 4> affine_tile_maps = {};
 
-  u32 latched_bg2x = 0;
-  u32 latched_bg2y = 0;
-  u32 latched_bg3x = 0;
-  u32 latched_bg3y = 0;
+  // internal affine reference points (20.8 fixed point), reloaded from BGxX/BGxY on write and at VBLANK
+  i32 latched_bg2x = 0;
+  i32 latched_bg2y = 0;
+  i32 latched_bg3x = 0;
+  i32 latched_bg3y = 0;
+
+  // BGxX/BGxY are 28 bit signed
+  static i32 sign_extend_reference(u32 v) { return static_cast<i32>(v << 4) >> 4; }
+
+  void reload_affine_reference();
+  void advance_affine_reference();
 
-  void reset_sprite_layer();
   u32* composite_bg_texture_buffer = new u32[512 * 512];
 
   DoubleBuffer db = DoubleBuffer(write_buf, disp_buf);
@@ -356,17 +430,72 @@ struct PPU {
       {3, "64x64"},
   };
 
-  [[nodiscard]] u32 get_color_by_index(u8 x, u8 palette_num, COLOR_DEPTH color_depth) const;
-  [[nodiscard]] u32 get_obj_color_by_index(u8 x, u8 palette_num, COLOR_DEPTH color_depth) const;
+  [[nodiscard]] u32 get_color_by_index(u8 x, u8 palette_num, COLOR_DEPTH color_depth) const {
+    return palette[color_depth == COLOR_DEPTH::BPP8 ? x : (palette_num * 16u) + x];
+  }
+  [[nodiscard]] u32 get_obj_color_by_index(u8 x, u8 palette_num, COLOR_DEPTH color_depth) const {
+    return palette[PALETTE_OBJ_OFFSET + (color_depth == COLOR_DEPTH::BPP8 ? x : (palette_num * 16u) + x)];
+  }
 
   void step();
-  void load_tiles(u8 bg, COLOR_DEPTH color_depth);
+
+  void draw_backdrop_scanline();
+
+  // fills BG2 of the current line from the mode 3/4/5 framebuffer, through the BG2 affine transform
+  void render_bitmap_scanline();
+
+  // the objects of the current line, into layer_lines[LAYER_OBJ]
+  void render_obj_scanline();
+
+  // fills window_mask for the current line, false when no window is on (everything enabled everywhere)
+  bool build_window_mask();
+
+  // picks the BLDCNT effect of every pixel of composite_line and writes the blended line, in host colours, to blended_line
+  void blend_scanline();
+
+  // resolves the layers of the current line (and the objects), applies windows and colour effects, writes it out
+  void compose_scanline();
+
+  // vram_offset is relative to the start of VRAM, 8bpp tiles span two units
+  const Tile& get_cached_tile(u32 vram_offset, COLOR_DEPTH color_depth);
+  const Tile& get_bg_tile(u8 bg, u16 tile_index, COLOR_DEPTH color_depth);
+
+  // called by the bus for every VRAM write, vram_offset is already unmirrored
+  void mark_vram_dirty(u32 vram_offset) {
+    u32 unit = vram_offset / TILE_UNIT_SIZE;
+
+    tile_dirty[0][unit] = true;
+    tile_dirty[1][unit] = true;
+    if (unit > 0) tile_dirty[1][unit - 1] = true;  // 8bpp tile starting one unit earlier covers these bytes too
+
+    if (vram_offset >= OBJ_DATA_OFFSET) {
+      u32 obj_tile = (vram_offset - OBJ_DATA_OFFSET) / TILE_UNIT_SIZE;
+
+      state.obj_tile_dirty[obj_tile] = true;
+      state.obj_tiles_changed        = true;
+    }
+  }
+
+  // called by the bus for every OAM write, a 16 bit write to attr2 also flags the affine group (harmless)
+  void mark_oam_dirty(u32 oam_offset) {
+    u32 entry = (oam_offset / 8) % 128;
+
+    if ((oam_offset % 8) < 6) state.oam_entry_dirty[entry] = true;
+    if ((oam_offset % 8) >= 4) state.oam_affine_dirty[entry / 4] = true;
+    state.oam_changed = true;
+  }
 
   void draw_mode_0_scanline();
 
   std::tuple<u16, u16> get_affine_bg_size(u8 bg_id);
 
   bool background_enabled(u8 bg_id);
+  bool bg_mosaic_enabled(u8 bg_id) const;
+
+  // true when vertical mosaic repeats an earlier line of the BG here, layer_lines still holds it
+  bool bg_mosaic_hold(u8 bg);
+  // horizontal mosaic over the line the BG just rendered, and keeps it around for vertical mosaic
+  void bg_mosaic_finish(u8 bg);
 
   u8 get_bg_prio(u8) const;
 
@@ -375,7 +504,7 @@ struct PPU {
   // ======= sprite =======
   std::string get_obj_size_string(const OAM_Entry&);
 
-  Tile get_obj_tile_by_tile_index(u16, COLOR_DEPTH);
+  const Tile& get_obj_tile_by_tile_index(u16, COLOR_DEPTH);
 
   // returns object height measured by the amount of tiles
   u8 get_obj_height(const OAM_Entry&);
@@ -385,14 +514,36 @@ struct PPU {
 
   bool is_valid_obj(const OAM_Entry&);
 
-  // re-renders the sprite table based on the current OAM & mapping mode
+  // re-renders the sprites whose attributes or tiles changed, and rebuilds the per line lists if anything did
   void repopulate_objs();
+  void decode_obj(u8 index);
+  void rebuild_obj_lines();
+  bool obj_uses_dirty_tile(const OAM_Entry&);
+
+  // tile id of the tile at (tile_x, tile_y) of the OBJ, depends on the mapping mode
+  u32 get_obj_tile_id(const OAM_Entry&, u32 tile_x, u32 tile_y);
+
+  // rotation/scaling parameter group selected in attr1
+  static u8 get_obj_affine_group(const OAM_Entry& e) { return static_cast<u8>((e.v >> 25) & 0x1F); }
 
   // ======= text mode =======
 
   u32 absolute_sbb(u8 bg, u8 map_x = 0);
+  u32 relative_sbb(u8 bg);
   u32 relative_cbb(u8 bg);
 
+  // reads the screen entry straight out of VRAM, no bus access (and no cycles) involved
+  ScreenBlockEntryMode0 get_text_screen_entry(u8 bg, u8 screen_size, u32 tile_x, u32 tile_y);
+
+  // count pixels of map line map_y, starting at map_x (wrapping around the map)
+  void render_text_bg_span(u8 bg, u8 screen_size, COLOR_DEPTH color_depth, u32 map_x, u32 map_y, u32 count, u8* index, bool* opaque);
+
+  // the visible part of the current line of a text BG, into bg_lines[bg]
+  void render_text_bg_scanline(u8 bg, u8 screen_size, COLOR_DEPTH color_depth);
+
+  // the whole map into tile_map_texture_buffer_arr[bg], for the BG viewer
+  void render_text_bg_texture(u8 bg);
+
   // Returns tuple containing BGxHOFS, BGxVOFS (in that order)
   std::tuple<u16, u16> get_text_bg_offset(u8 bg_id) const;
   std::tuple<u16, u16> get_render_offset(u8 screen_size);
@@ -39,9 +39,24 @@ const std::unordered_map<BANK_MODE, std::string> mode_map = {
 };
 enum CPU_MODE : u8 { ARM_MODE, THUMB_MODE };
 
+enum struct FLAG_OP : u8 { NONE, LOGICAL, ADD, SUB };
+
 struct Registers {
-  // Returns a reference to currently banked register.
-  u32& get_reg(u8 i);
+  // Returns a reference to the register as the current mode sees it, r always holds the active bank.
+  u32& get_reg(u8 i) { return r[i]; }
+
+  // The one place banking happens: r8-r14 of `from` go back to their bank, the ones `to` sees come in.
+  // Doesn't touch CPSR, anything that changes MODE_BIT calls it with the old and the new mode.
+  void switch_bank(BANK_MODE from, BANK_MODE to);
+  void switch_mode(BANK_MODE mode) {
+    switch_bank(CPSR.MODE_BIT, mode);
+    CPSR.MODE_BIT = mode;
+  }
+
+  // the USER/SYSTEM copy of a register, for LDM/STM with the S bit
+  u32& user_reg(u8 i);
+  // where r8-r14 of a mode are kept while it isn't active
+  u32* bank(BANK_MODE mode);
 
   Registers() {
     CPSR.MODE_BIT  = SYSTEM;
@@ -57,20 +72,45 @@ struct Registers {
   std::string get_mode_string(BANK_MODE bm);
   void load_spsr_to_cpsr();
   u32 get_spsr(BANK_MODE m);
+
+  // NZCV of the last ALU op that set them, kept as its operands until something reads the flags.
+  // LOGICAL only holds N and Z (C and V are already in CPSR), ADD and SUB hold all four.
+  // Anything that reads or writes the flags in CPSR directly has to sync_flags() first.
   struct {
-    // used as reference during invalid modes
-    u32 zero = 0;
+    FLAG_OP op = FLAG_OP::NONE;
+    u32 result = 0;
+    u32 op1    = 0;
+    u32 op2    = 0;
+  } lazy_flags;
 
+  void sync_flags() {
+    if (lazy_flags.op != FLAG_OP::NONE) materialize_flags();
+  }
+  void materialize_flags();
+
+  void set_logical_flags(u32 result) {
+    if (lazy_flags.op > FLAG_OP::LOGICAL) materialize_flags();  // C and V of a pending ADD/SUB still count
+
+    lazy_flags.op     = FLAG_OP::LOGICAL;
+    lazy_flags.result = result;
+  }
+  void set_add_flags(u32 op1, u32 op2, u32 result) { lazy_flags = {FLAG_OP::ADD, result, op1, op2}; }
+  void set_sub_flags(u32 op1, u32 op2, u32 result) { lazy_flags = {FLAG_OP::SUB, result, op1, op2}; }
+
+  struct {
     // R13 (SP)
     // R14 (LR)
     // R15 (PC)
     u32 r[16] = {};
 
+    // r8-r14 of the modes that aren't active, at their own index
+    u32 usr_r[16] = {};
     u32 fiq_r[16] = {};
     u32 svc_r[16] = {};
     u32 abt_r[16] = {};
     u32 irq_r[16] = {};
     u32 und_r[16] = {};
+    u32 inv_r[16] = {};  // invalid modes
 
     u32 SPSR_fiq = 0;
     u32 SPSR_svc = 0;
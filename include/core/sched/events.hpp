@@ -0,0 +1,5 @@
+#pragma once
+
+#include "common/defs.hpp"
+
+enum class EventType : u8 { VBLANK, HBLANK_START, HBLANK_END, TIMER0_OVERFLOW, TIMER1_OVERFLOW, TIMER2_OVERFLOW, TIMER3_OVERFLOW, COUNT };
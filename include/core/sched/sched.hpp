@@ -1,31 +1,66 @@
 #pragma once
 
-#include <functional>
-#include <queue>
+#include <array>
+#include <limits>
 
-#include "agb.hpp"
+#include "bus.hpp"
 #include "common/defs.hpp"
+#include "sched/events.hpp"
 #include "spdlog/fmt/bundled/base.h"
-namespace Scheduler {
-  enum class EventType { VBLANK, HBLANK_START, HBLANK_END, TIMER0_START };
+
+struct AGB;
+
+// Min-heap indexed by event type. Every EventType owns at most one slot, so scheduling
+// an event that is already pending moves it instead of adding a duplicate, and the heap
+// never holds more than EVENT_TYPE_COUNT entries.
+struct Scheduler {
+  using EventType = ::EventType;
+
+  static constexpr u8 EVENT_TYPE_COUNT = static_cast<u8>(EventType::COUNT);
+  static constexpr u8 NOT_SCHEDULED    = 0xFF;
+  static constexpr u64 NO_EVENT        = std::numeric_limits<u64>::max();
+
+  // cycles_elapsed gets rebased once it crosses this, keeps every timestamp far away from overflowing
+  static constexpr u64 REBASE_THRESHOLD = 1ULL << 40;
 
   struct Event {
     EventType type;
     u64 timestamp;  // cycle count
   };
 
-  struct EventCompare {
-    bool operator()(const Event& l, const Event& r) const { return l.timestamp > r.timestamp; };
-  };
+  std::array<Event, EVENT_TYPE_COUNT> heap  = {};
+  std::array<u8, EVENT_TYPE_COUNT> position = {};  // heap index of each event type, NOT_SCHEDULED if not pending
+  u8 size                                   = 0;
 
-  static std::priority_queue<Event, std::vector<Event>, EventCompare> event_queue;
+  u64 next_event_timestamp = NO_EVENT;
+
+  // an event got scheduled ahead of the one that was next (a timer started mid batch), the cpu batch that
+  // targets the old one has to stop early. cleared when a batch starts
+  bool preempted = false;
+
+  Scheduler() { position.fill(NOT_SCHEDULED); }
 
   // Returns timestamp adjusted by the difference of the timestamp when an event is processed, and when it was scheduled.
-  i64 get_diff_adjusted_timestamp(const Event& e, u64 current_timestamp, u64 target_timestamp);
+  static u64 get_diff_adjusted_timestamp(const Event& e, u64 current_timestamp, u64 target_timestamp);
 
-  void cycle_by(u32 cycles);
   void schedule(EventType e, u64 when);
-  void step(AGB& agb, u32 cycles);
+  void cancel(EventType e);
+  [[nodiscard]] bool is_scheduled(EventType e) const { return position[static_cast<u8>(e)] != NOT_SCHEDULED; }
+  [[nodiscard]] bool empty() const { return size == 0; }
+
+  // single compare in the hot path, events only get dispatched once the next one is due
+  void step(AGB& agb) {
+    if (cycles_elapsed < next_event_timestamp) return;
+    process_events(agb);
+  }
+
+  void process_events(AGB& agb);
+  void rebase(AGB& agb);
+
+  void print_scheduled_events() const;
 
-  void print_scheduled_events();
-}  // namespace Scheduler
\ No newline at end of file
+  void sift_up(u8 idx);
+  void sift_down(u8 idx);
+  void swap_slots(u8 a, u8 b);
+  void remove_at(u8 idx);
+};
@@ -4,16 +4,19 @@
 
 #include "common/defs.hpp"
 #include "enums.hpp"
+#include "sched/events.hpp"
 
 struct Bus;
 
+// Timers don't tick, the counter is derived from the cycle it started counting at,
+// and an overflow event is put on the scheduler for the cycle the counter wraps.
 struct Timer {
   Timer();
 
-  u64 start_time  = 0;
-  u16 start_value = 0;
-  bool use_delta = false;
-  
+  u64 start_time         = 0;  // cycle at which the counter held start_value
+  u16 start_value        = 0;
+  u64 overflow_timestamp = 0;  // cycle of the currently scheduled overflow event
+
   union {
     u16 v;
     struct {
@@ -26,17 +29,25 @@ struct Timer {
     };
   } ctrl = {};
 
-  Bus* bus = nullptr;
+  Bus* bus    = nullptr;
+  Timer* next = nullptr;  // timer that counts up on our overflow (cascade)
 
   u8 id;
 
-  u16 counter      = 0;
+  u16 counter      = 0;  // only up to date while stopped or cascading, use get_counter()
   u16 reload_value = 0;
 
-  void tick(u64 cycles);
-  void reload_counter();
+  void write_control(u8 byte, u8 value);
+  void overflow(u64 timestamp);
+  void count_up(u64 timestamp);
+  void schedule_overflow();
+  void rebase(u64 base);
+
+  [[nodiscard]] u16 get_counter() const;
+  [[nodiscard]] bool is_cascading() const;
   [[nodiscard]] u16 get_divider_val() const;
 
+  [[nodiscard]] EventType get_overflow_event() const;
   [[nodiscard]] INTERRUPT_TYPE get_timer_interrupt() const;
   [[nodiscard]] std::string get_prescaler_string() const;
-};
\ No newline at end of file
+};
@@ -12,13 +12,14 @@ AGB::AGB() {
   bus.ppu        = &ppu;
   ppu.bus        = &bus;
   bus.apu        = &apu;
-  Scheduler::agb = this;
+  bus.scheduler  = &scheduler;
 
   pak.flash_controller.SRAM = &pak.SRAM;
 
   for (u8 i = 0; i < 4; i++) {
     dma_channels[i] = std::make_shared<DMAContext>(&bus);
     timers[i].bus   = &bus;
+    timers[i].next  = i < 3 ? &timers[i + 1] : nullptr;
   }
 
   bus.ch0 = dma_channels[0];
@@ -31,63 +32,117 @@ AGB::AGB() {
   bus.tm2 = &timers[2];
   bus.tm3 = &timers[3];
 
-  // Scheduler::schedule(Scheduler::EventType::HBLANK_START, 1006);
-  // Scheduler::schedule(Scheduler::EventType::VBLANK, 197120);
+  bus.map_fastmem_pages();
+
+  // scheduler.schedule(EventType::HBLANK_START, 1006);
+  // scheduler.schedule(EventType::VBLANK, 197120);
+}
+
+// Where the BIOS leaves things when it jumps to the cartridge:
+//   r0-r12 0, SP_svc 0x03007FE0, SP_irq 0x03007FA0, SP_usr/sys 0x03007F00, the other banks and SPSRs 0
+//   CPSR 0x1F, system mode, ARM, IRQ and FIQ enabled, PC 0x08000000
+//   DISPCNT 0x0080 (forced blank from RegisterRamReset), KEYCNT 0, RCNT 0x8000 (general purpose), IE/IF/IME 0,
+//   WAITCNT 0, POSTFLG 1, SOUNDBIAS 0x200
+//   the BIOS open bus value being the last opcode it fetched
+void AGB::direct_boot() {
+  cpu.regs = {};
+
+  cpu.regs.switch_mode(SUPERVISOR);
+  cpu.regs.r[13]    = 0x03007FE0;
+  cpu.regs.SPSR_svc = 0;
+  cpu.regs.switch_mode(IRQ);
+  cpu.regs.r[13]    = 0x03007FA0;
+  cpu.regs.SPSR_irq = 0;
+  cpu.regs.switch_mode(SYSTEM);
+  cpu.regs.r[13] = 0x03007F00;
+
+  cpu.regs.CPSR.value = 0x1F;
+
+  cpu.regs.r[15] = 0x08000000;
+  cpu.flush_pipeline();
+  cpu.regs.r[15] += 4;  // the half of the pipeline refill step() would have done
+
+  const u64 saved_cycles = cycles_elapsed;  // the BIOS is done by now, these don't cost the cartridge anything
+  bus.write16(DISPCNT, 0x0080);
+  bus.write16(KEYCNT, 0);
+  bus.write16(RCNT, 0x8000);
+  bus.write16(IE, 0);
+  bus.write16(IF, 0);
+  bus.write16(IME, 0);
+  bus.write32(WAITCNT, 0);
+  bus.write8(POSTFLG, 1);
+  bus.write16(SOUNDBIAS, 0x200);
+  cycles_elapsed = saved_cycles;
+
+  bus.bios_open_bus = 0xE129F000;  // last opcode the BIOS fetches before jumping to the cartridge
+}
+
+void AGB::bios_boot() {
+  cpu.regs = {};
+  cpu.regs.switch_mode(SUPERVISOR);
+  cpu.regs.CPSR.irq_disable = true;
+  cpu.regs.CPSR.fiq_disable = true;
+
+  cpu.regs.r[15] = 0x00000000;
+  cpu.flush_pipeline();
+  cpu.regs.r[15] += 4;
+}
+
+// immediate transfers, requested by the bus when a channel gets enabled
+void AGB::check_for_dma() {
+  bus.dma_requested = false;
+  trigger_dma(DMA_START_TIMING::IMMEDIATELY);
 }
 
-void AGB::check_for_dma() const {
+// called from the scheduler at the event the channel start timing is waiting for
+void AGB::trigger_dma(DMA_START_TIMING timing) const {
   for (auto& ch : dma_channels) {
-    if (ch->enabled() && start_timing_cond_met(ch.get())) ch->process();
+    if (ch->enabled() && ch->dmacnt_h.start_timing == timing) ch->process();
   }
-};
-
-bool AGB::start_timing_cond_met(DMAContext* ch) const {
-  switch (ch->dmacnt_h.start_timing) {
-    case DMA_START_TIMING::IMMEDIATELY: return true;
-    case DMA_START_TIMING::VBLANK: return ppu.display_fields.DISPSTAT.VBLANK_FLAG;
-    case DMA_START_TIMING::HBLANK: return ppu.display_fields.DISPSTAT.HBLANK_FLAG;
-    case DMA_START_TIMING::SPECIAL: {
-      return false;
-      switch (ch->id) {
-        case 0: return false;
-        case 1: return false;  // FIFO req
-        case 2: return false;  // FIFO req
-        case 3: return false;
-        default: assert(0);
-      }
-    }
+}
+
+// Nothing executes while halted, and only an event can raise an interrupt, so time skips
+// straight to the next event instead of spinning through cycles.
+void AGB::check_halt() {
+  if (cpu.interrupt_queued()) {
+    cpu.halted = false;
+    return;
   }
 
-  assert(0);
+  if (!scheduler.empty()) cycles_elapsed = std::max(cycles_elapsed, scheduler.next_event_timestamp);
 }
 
-void AGB::tick_timers(u64 cycles) {
-  for (Timer& t : timers) {
-    t.tick(cycles);
-  }
+void AGB::schedule_ppu_events() {
+  scheduler.schedule(EventType::HBLANK_START, 1006);
+  scheduler.schedule(EventType::VBLANK, 197120);
 }
 
 void AGB::system_loop() {
-  Scheduler::schedule(Scheduler::EventType::HBLANK_START, 1006);
-  Scheduler::schedule(Scheduler::EventType::VBLANK, 197120);
-
-  while (active) {
-    u32 cycles = 0;
+  schedule_ppu_events();
 
-    cycles += cpu.step();
+  while (active) run_slice();
+}
 
-    check_for_dma();
-    Scheduler::step(cycles);
-    // tick_timers(cycles);
+// one cpu batch up to the next event, then whatever ended the batch
+void AGB::run_slice() {
+  if (cpu.halted) {
+    check_halt();
+  } else {
+    scheduler.preempted = false;
+    cpu.run_until(scheduler.next_event_timestamp);
   }
+
+  if (bus.dma_requested) check_for_dma();
+  scheduler.step(*this);
 }
 
 void AGB::step() {
-  u32 cycles = 0;
-
-  cycles += cpu.step();
+  if (cpu.halted) {
+    check_halt();
+  } else {
+    cpu.step();
+  }
 
-  Scheduler::step(cycles);
-  // tick_timers(cycles);
-  check_for_dma();
+  if (bus.dma_requested) check_for_dma();
+  scheduler.step(*this);
 }
\ No newline at end of file
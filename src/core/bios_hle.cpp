@@ -0,0 +1,642 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <numbers>
+#include <vector>
+
+#include "bus.hpp"
+#include "core/cpu.hpp"
+
+// What a BIOS call sees and leaves behind. Arguments come in through r0-r3, results go back the same way.
+// A dry run (check mode) keeps its results here instead, the BIOS still gets to run the call for real.
+struct HleCall {
+  Bus& bus;
+  bool dry;
+
+  std::array<u32, 4> r = {};
+  u16 reg_mask         = 0;  // registers the call sets
+  u64 cost             = 0;  // cycles the BIOS would have spent, roughly
+
+  std::vector<ARM7TDMI::HleWrite>* journal;
+
+  void set(u8 i, u32 value) {
+    r[i] = value;
+    reg_mask |= 1 << i;
+  }
+
+  u8 read8(u32 address) { return bus.read8(address); }
+  u16 read16(u32 address) { return bus.read16(address); }
+  u32 read32(u32 address) { return bus.read32(address); }
+
+  // size bytes from address, a memcpy per fastmem page where there is one
+  void read(u32 address, u8* out, u32 size, ACCESS_WIDTH width) {
+    const u32 unit = 1 << static_cast<u8>(width);
+
+    while (size != 0) {
+      const Bus::FastmemPage* page = bus.get_read_page(address);
+      if (page == nullptr) {
+        const u32 value = read_unit(address, width);
+        std::memcpy(out, &value, unit);
+        address += unit, out += unit, size -= unit;
+        continue;
+      }
+
+      const u32 offset = address & page->mask;
+      const u32 chunk  = std::min({size, page->mask + 1 - offset, Bus::PAGE_SIZE - (address & (Bus::PAGE_SIZE - 1))});
+      std::memcpy(out, page->ptr + offset, chunk);
+      address += chunk, out += chunk, size -= chunk;
+    }
+  }
+
+  // The same memory state a run of write8/16/32 would leave, without going through the bus for every unit.
+  void write(u32 address, const u8* data, u32 size, ACCESS_WIDTH width) {
+    const u32 unit = 1 << static_cast<u8>(width);
+
+    if (dry) {
+      for (u32 i = 0; i < size; i += unit) journal->push_back({address + i, read_le(data + i, unit), width});
+      return;
+    }
+
+    while (size != 0) {
+      const Bus::FastmemPage* page = bus.get_write_page(address);
+      if (page == nullptr || (width == ACCESS_WIDTH::BYTE && (page->flags & Bus::PAGE_NO_BYTE_WRITES))) {
+        write_unit(address, read_le(data, unit), width);
+        address += unit, data += unit, size -= unit;
+        continue;
+      }
+
+      const u32 offset = address & page->mask;
+      const u32 chunk  = std::min({size, page->mask + 1 - offset, Bus::PAGE_SIZE - (address & (Bus::PAGE_SIZE - 1))});
+      std::memcpy(page->ptr + offset, data, chunk);
+
+      if (page->flags & Bus::PAGE_CODE) {
+        for (u32 a = address; a < address + chunk; a += 1 << Bus::CODE_PAGE_SHIFT) bus.note_code_write(a);
+        bus.note_code_write(address + chunk - 1);
+      }
+      if (page->flags & Bus::PAGE_SIDE_EFFECTS) {
+        for (u32 a = address; a < address + chunk; a += unit) bus.handle_write_side_effects(a);
+      }
+
+      address += chunk, data += chunk, size -= chunk;
+    }
+  }
+
+  void write16(u32 address, u16 value) { write(address, reinterpret_cast<const u8*>(&value), 2, ACCESS_WIDTH::HALFWORD); }
+  void write32(u32 address, u32 value) { write(address, reinterpret_cast<const u8*>(&value), 4, ACCESS_WIDTH::WORD); }
+
+  // what the BIOS charges per unit moved, on top of a fixed amount for the call itself
+  [[nodiscard]] u64 access_cost(u32 src, u32 dst, ACCESS_WIDTH width) const {
+    return bus.get_access_cycles(src, width, ACCESS_TYPE::SEQUENTIAL) + bus.get_access_cycles(dst, width, ACCESS_TYPE::SEQUENTIAL);
+  }
+
+ private:
+  static u32 read_le(const u8* p, u32 unit) {
+    u32 v = 0;
+    std::memcpy(&v, p, unit);
+    return v;
+  }
+
+  u32 read_unit(u32 address, ACCESS_WIDTH width) {
+    switch (width) {
+      case ACCESS_WIDTH::BYTE: return bus.read8(address);
+      case ACCESS_WIDTH::HALFWORD: return bus.read16(address);
+      case ACCESS_WIDTH::WORD: return bus.read32(address);
+    }
+    return 0;
+  }
+
+  void write_unit(u32 address, u32 value, ACCESS_WIDTH width) {
+    switch (width) {
+      case ACCESS_WIDTH::BYTE: bus.write8(address, static_cast<u8>(value)); break;
+      case ACCESS_WIDTH::HALFWORD: bus.write16(address, static_cast<u16>(value)); break;
+      case ACCESS_WIDTH::WORD: bus.write32(address, value); break;
+    }
+  }
+};
+
+// The BIOS copies front to back, a destination inside the source picks up what it already copied.
+static void forward_overlap(std::vector<u8>& data, u32 src, u32 dst, u32 unit) {
+  if (dst <= src || dst - src >= data.size()) return;
+
+  for (u32 i = dst - src; i < data.size(); i += unit) std::memcpy(&data[i], &data[i - (dst - src)], unit);
+}
+
+// the BIOS refuses to read from itself
+static bool source_in_bios(u32 src) { return (src & 0x0E000000) == 0; }
+
+// 1.14 fixed point, a quarter turn is 64 entries. Same values as the table in the BIOS.
+static const std::array<i16, 256> sine_table = [] {
+  std::array<i16, 256> table = {};
+  for (u32 i = 0; i < table.size(); i++) table[i] = static_cast<i16>(std::lround(std::sin(i * std::numbers::pi / 128) * 0x4000));
+  return table;
+}();
+
+static i32 sine(u16 theta) { return sine_table[theta >> 8]; }
+static i32 cosine(u16 theta) { return sine_table[((theta >> 8) + 64) & 0xFF]; }
+
+// SWI 0x06, r0 / r1. Division by 0 hangs the BIOS, that one's left to it.
+static bool div(HleCall& c, i32 num, i32 den) {
+  if (den == 0) return false;
+  if (num == INT32_MIN && den == -1) return false;
+
+  const i32 quot = num / den;
+
+  c.set(0, static_cast<u32>(quot));
+  c.set(1, static_cast<u32>(num % den));
+  c.set(3, static_cast<u32>(std::abs(quot)));
+  c.cost = 100;
+  return true;
+}
+
+// SWI 0x08
+static bool sqrt(HleCall& c) {
+  u64 rem  = c.r[0];
+  u64 root = 0;
+
+  for (u64 bit = 1ULL << 30; bit != 0; bit >>= 2) {
+    if (rem >= root + bit) {
+      rem -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+  }
+
+  c.set(0, static_cast<u32>(root));
+  c.cost = 200;
+  return true;
+}
+
+// SWI 0x0B, r0 source, r1 destination, r2 count | fill << 24 | 32 bit << 26
+static bool cpu_set(HleCall& c) {
+  const u32 ctrl       = c.r[2];
+  const u32 count      = ctrl & 0x1FFFFF;
+  const bool fill      = ctrl & (1 << 24);
+  const bool word      = ctrl & (1 << 26);
+  const u32 unit       = word ? 4 : 2;
+  const ACCESS_WIDTH w = word ? ACCESS_WIDTH::WORD : ACCESS_WIDTH::HALFWORD;
+  const u32 src        = c.r[0] & ~(unit - 1);
+  const u32 dst        = c.r[1] & ~(unit - 1);
+
+  c.cost = 20;
+  if (source_in_bios(src) || count == 0) return true;
+
+  std::vector<u8> data(count * unit);
+  if (fill) {
+    c.read(src, data.data(), unit, w);
+    for (u32 i = unit; i < data.size(); i += unit) std::memcpy(&data[i], data.data(), unit);
+  } else {
+    c.read(src, data.data(), count * unit, w);
+    forward_overlap(data, src, dst, unit);
+  }
+
+  c.write(dst, data.data(), count * unit, w);
+  c.cost += count * (c.access_cost(src, dst, w) + 6);
+  return true;
+}
+
+// SWI 0x0C, CpuSet in words, 8 at a time
+static bool cpu_fast_set(HleCall& c) {
+  const u32 ctrl  = c.r[2];
+  const u32 count = ((ctrl & 0x1FFFFF) + 7) & ~7U;
+  const bool fill = ctrl & (1 << 24);
+  const u32 src   = c.r[0] & ~3U;
+  const u32 dst   = c.r[1] & ~3U;
+
+  c.cost = 20;
+  if (source_in_bios(src) || count == 0) return true;
+
+  std::vector<u8> data(count * 4);
+  if (fill) {
+    c.read(src, data.data(), 4, ACCESS_WIDTH::WORD);
+    for (u32 i = 4; i < data.size(); i += 4) std::memcpy(&data[i], data.data(), 4);
+  } else {
+    c.read(src, data.data(), count * 4, ACCESS_WIDTH::WORD);
+    forward_overlap(data, src, dst, 4);
+  }
+
+  c.write(dst, data.data(), count * 4, ACCESS_WIDTH::WORD);
+  c.cost += count * (c.access_cost(src, dst, ACCESS_WIDTH::WORD) + 1);
+  return true;
+}
+
+// ARM multiply, then the shift. Wraps around the same way.
+static i32 mul_asr(i32 a, i32 b, u8 shift) { return static_cast<i32>(static_cast<i64>(a) * b) >> shift; }
+
+// Polynomial approximation the BIOS uses, tan in 1.14 to an angle between -0x4000 and 0x4000 (-pi/2, pi/2).
+// It leaves its intermediate values in r1 and r3.
+static i32 arctan(HleCall& c, i32 tan) {
+  const i32 a = -mul_asr(tan, tan, 14);
+  i32 b       = mul_asr(0xA9, a, 14) + 0x390;
+
+  for (const i32 k : {0x91C, 0xFB6, 0x16AA, 0x2081, 0x3651, 0xA2F9}) b = mul_asr(b, a, 14) + k;
+
+  c.set(1, static_cast<u32>(a));
+  c.set(3, static_cast<u32>(b));
+  c.cost += 60;
+  return mul_asr(tan, b, 16);
+}
+
+// SWI 0x09, r0 tan
+static bool arctan(HleCall& c) {
+  c.set(0, static_cast<u32>(arctan(c, static_cast<i32>(c.r[0]))));
+  return true;
+}
+
+// SWI 0x0A, r0 x, r1 y (1.14). The full turn as 0x0000-0xFFFF, the octant picks which ratio goes into ArcTan.
+static bool arctan2(HleCall& c) {
+  const i32 x = static_cast<i32>(c.r[0]);
+  const i32 y = static_cast<i32>(c.r[1]);
+
+  i32 angle = 0;
+  if (y == 0) {
+    angle = x >= 0 ? 0 : 0x8000;
+  } else if (x == 0) {
+    angle = y >= 0 ? 0x4000 : 0xC000;
+  } else if (y >= 0) {
+    if (x >= 0 && x >= y) angle = arctan(c, (y << 14) / x);
+    else if (x < 0 && -x >= y) angle = arctan(c, (y << 14) / x) + 0x8000;
+    else angle = 0x4000 - arctan(c, (x << 14) / y);
+  } else {
+    if (x <= 0 && -x > -y) angle = arctan(c, (y << 14) / x) + 0x8000;
+    else if (x > 0 && x >= -y) angle = arctan(c, (y << 14) / x) + 0x10000;
+    else angle = 0xC000 - arctan(c, (x << 14) / y);
+  }
+
+  c.set(0, static_cast<u16>(angle));
+  c.set(3, 0x170);
+  c.cost += 40;
+  return true;
+}
+
+// SWI 0x0D, what the GBA BIOS sums up to
+static bool get_bios_checksum(HleCall& c) {
+  c.set(0, 0xBAAE187F);
+  c.set(1, 1);
+  c.set(3, 0x4000);
+  c.cost = 0x4000 * 3;
+  return true;
+}
+
+// SWI 0x0E, r0 source, r1 destination, r2 count
+// source: s32 ox, oy (19.8), s16 cx, cy, s16 sx, sy (8.8), u16 theta, 2 bytes padding
+// destination: s16 pa, pb, pc, pd, s32 x, y
+static bool bg_affine_set(HleCall& c) {
+  u32 src = c.r[0];
+  u32 dst = c.r[1];
+
+  for (u32 i = 0; i < c.r[2]; i++, src += 20, dst += 16) {
+    const i32 ox    = static_cast<i32>(c.read32(src));
+    const i32 oy    = static_cast<i32>(c.read32(src + 4));
+    const i32 cx    = static_cast<i16>(c.read16(src + 8));
+    const i32 cy    = static_cast<i16>(c.read16(src + 10));
+    const i32 sx    = static_cast<i16>(c.read16(src + 12));
+    const i32 sy    = static_cast<i16>(c.read16(src + 14));
+    const u16 theta = c.read16(src + 16);
+
+    const i32 pa = (sx * cosine(theta)) >> 14;
+    const i32 pb = -((sx * sine(theta)) >> 14);
+    const i32 pc = (sy * sine(theta)) >> 14;
+    const i32 pd = (sy * cosine(theta)) >> 14;
+
+    c.write16(dst, static_cast<u16>(pa));
+    c.write16(dst + 2, static_cast<u16>(pb));
+    c.write16(dst + 4, static_cast<u16>(pc));
+    c.write16(dst + 6, static_cast<u16>(pd));
+    c.write32(dst + 8, static_cast<u32>(ox - (pa * cx + pb * cy)));
+    c.write32(dst + 12, static_cast<u32>(oy - (pc * cx + pd * cy)));
+  }
+
+  c.cost = 20 + (c.r[2] * 60);
+  return true;
+}
+
+// SWI 0x0F, r0 source, r1 destination, r2 count, r3 distance between pa/pb/pc/pd (2 packed, 8 for OAM)
+// source: s16 sx, sy (8.8), u16 theta, 2 bytes padding
+static bool obj_affine_set(HleCall& c) {
+  u32 src          = c.r[0];
+  u32 dst          = c.r[1];
+  const u32 stride = c.r[3];
+
+  for (u32 i = 0; i < c.r[2]; i++, src += 8, dst += stride * 4) {
+    const i32 sx    = static_cast<i16>(c.read16(src));
+    const i32 sy    = static_cast<i16>(c.read16(src + 2));
+    const u16 theta = c.read16(src + 4);
+
+    c.write16(dst, static_cast<u16>((sx * cosine(theta)) >> 14));
+    c.write16(dst + stride, static_cast<u16>(-((sx * sine(theta)) >> 14)));
+    c.write16(dst + (stride * 2), static_cast<u16>((sy * sine(theta)) >> 14));
+    c.write16(dst + (stride * 3), static_cast<u16>((sy * cosine(theta)) >> 14));
+  }
+
+  c.cost = 20 + (c.r[2] * 40);
+  return true;
+}
+
+// The decompressors produce everything into a buffer first and store it in one go. The Wram versions write
+// bytes, the Vram ones halfwords (an odd trailing byte is dropped, like the BIOS does), Huffman words.
+static void store_output(HleCall& c, u32 dst, std::vector<u8>& out, ACCESS_WIDTH width) {
+  const u32 unit = 1 << static_cast<u8>(width);
+  out.resize(out.size() & ~static_cast<size_t>(unit - 1));
+
+  c.write(dst & ~(unit - 1), out.data(), static_cast<u32>(out.size()), width);
+}
+
+// SWI 0x10, r0 source, r1 destination, r2 info
+// info: u16 source length in bytes, u8 source width, u8 destination width, u32 offset (bit 31 adds it to zeroes too)
+static bool bit_unpack(HleCall& c) {
+  const u32 src          = c.r[0];
+  const u32 length       = c.read16(c.r[2]);
+  const u8 src_width     = c.read8(c.r[2] + 2);
+  const u8 dst_width     = c.read8(c.r[2] + 3);
+  const u32 info_offset  = c.read32(c.r[2] + 4);
+  const u32 offset       = info_offset & 0x7FFFFFFF;
+  const bool offset_zero = info_offset & 0x80000000;
+
+  if (!std::has_single_bit(src_width) || src_width > 8) return false;
+  if (!std::has_single_bit(dst_width) || dst_width > 32) return false;
+  if (source_in_bios(src)) return true;
+
+  const u32 mask = (1u << src_width) - 1;
+  u32 word       = 0;
+  u32 shift      = 0;
+
+  std::vector<u8> out;
+  out.reserve(length * 8 / src_width * dst_width / 8);
+
+  for (u32 i = 0; i < length; i++) {
+    const u8 data = c.read8(src + i);
+
+    for (u32 bit = 0; bit < 8; bit += src_width) {
+      u32 value = (data >> bit) & mask;
+      if (value != 0 || offset_zero) value += offset;
+
+      word |= value << shift;
+      shift += dst_width;
+
+      if (shift == 32) {
+        for (u32 b = 0; b < 4; b++) out.push_back(static_cast<u8>(word >> (b * 8)));
+        word  = 0;
+        shift = 0;
+      }
+    }
+  }
+
+  store_output(c, c.r[1], out, ACCESS_WIDTH::WORD);
+  c.cost = 40 + (length * 8 / src_width * 6);
+  return true;
+}
+
+// SWI 0x11/0x12, r0 source, r1 destination
+static bool lz77_uncomp(HleCall& c, ACCESS_WIDTH width) {
+  u32 src = c.r[0];
+  if (source_in_bios(src)) return true;
+
+  const u32 size = c.read32(src) >> 8;
+  src += 4;
+
+  std::vector<u8> out;
+  out.reserve(size);
+
+  while (out.size() < size) {
+    const u8 flags = c.read8(src++);
+
+    for (u8 bit = 0; bit < 8 && out.size() < size; bit++) {
+      if (!(flags & (0x80 >> bit))) {
+        out.push_back(c.read8(src++));
+        continue;
+      }
+
+      const u8 b0     = c.read8(src++);
+      const u8 b1     = c.read8(src++);
+      const u32 disp  = (((b0 & 0xF) << 8) | b1) + 1;
+      const u32 count = (b0 >> 4) + 3;
+
+      for (u32 i = 0; i < count && out.size() < size; i++) out.push_back(disp <= out.size() ? out[out.size() - disp] : 0);
+    }
+  }
+
+  store_output(c, c.r[1], out, width);
+  c.cost = 40 + (size * 12);
+  return true;
+}
+
+// SWI 0x13, r0 source, r1 destination
+static bool huff_uncomp(HleCall& c) {
+  u32 src = c.r[0];
+  if (source_in_bios(src)) return true;
+
+  const u32 header = c.read32(src);
+  const u32 bits   = header & 0xF;
+  const u32 size   = header >> 8;
+  if (bits != 4 && bits != 8) return false;
+
+  const u32 tree      = src + 5;  // root node
+  u32 stream          = src + 4 + ((c.read8(src + 4) + 1) * 2);
+  u32 node            = tree;
+  u32 word            = 0;
+  u32 shift           = 0;
+  std::vector<u8> out = {};
+  out.reserve(size + 4);
+
+  while (out.size() < size) {
+    const u32 data = c.read32(stream);
+    stream += 4;
+
+    for (i32 bit = 31; bit >= 0 && out.size() < size; bit--) {
+      const u8 value  = c.read8(node);
+      const u32 next  = (node & ~1U) + ((value & 0x3F) * 2) + 2;
+      const bool one  = data & (1U << bit);
+      const bool leaf = value & (one ? 0x40 : 0x80);
+
+      node = next + (one ? 1 : 0);
+      if (!leaf) continue;
+
+      word |= static_cast<u32>(c.read8(node) & ((1 << bits) - 1)) << shift;
+      shift += bits;
+      node = tree;
+
+      if (shift == 32) {
+        for (u32 i = 0; i < 4; i++) out.push_back(static_cast<u8>(word >> (i * 8)));
+        word  = 0;
+        shift = 0;
+      }
+    }
+  }
+
+  store_output(c, c.r[1], out, ACCESS_WIDTH::WORD);
+  c.cost = 40 + (size * 30);
+  return true;
+}
+
+// SWI 0x14/0x15, r0 source, r1 destination
+static bool rl_uncomp(HleCall& c, ACCESS_WIDTH width) {
+  u32 src = c.r[0];
+  if (source_in_bios(src)) return true;
+
+  const u32 size = c.read32(src) >> 8;
+  src += 4;
+
+  std::vector<u8> out;
+  out.reserve(size);
+
+  while (out.size() < size) {
+    const u8 flag = c.read8(src++);
+
+    if (flag & 0x80) {
+      const u8 value = c.read8(src++);
+      for (u32 i = 0; i < (flag & 0x7Fu) + 3 && out.size() < size; i++) out.push_back(value);
+    } else {
+      for (u32 i = 0; i < (flag & 0x7Fu) + 1 && out.size() < size; i++) out.push_back(c.read8(src++));
+    }
+  }
+
+  store_output(c, c.r[1], out, width);
+  c.cost = 40 + (size * 8);
+  return true;
+}
+
+static bool run_call(HleCall& c, u8 number) {
+  switch (number) {
+    case 0x06: return div(c, static_cast<i32>(c.r[0]), static_cast<i32>(c.r[1]));
+    case 0x07: return div(c, static_cast<i32>(c.r[1]), static_cast<i32>(c.r[0]));  // DivArm
+    case 0x08: return sqrt(c);
+    case 0x09: return arctan(c);
+    case 0x0A: return arctan2(c);
+    case 0x0B: return cpu_set(c);
+    case 0x0C: return cpu_fast_set(c);
+    case 0x0D: return get_bios_checksum(c);
+    case 0x0E: return bg_affine_set(c);
+    case 0x0F: return obj_affine_set(c);
+    case 0x10: return bit_unpack(c);
+    case 0x11: return lz77_uncomp(c, ACCESS_WIDTH::BYTE);
+    case 0x12: return lz77_uncomp(c, ACCESS_WIDTH::HALFWORD);
+    case 0x13: return huff_uncomp(c);
+    case 0x14: return rl_uncomp(c, ACCESS_WIDTH::BYTE);
+    case 0x15: return rl_uncomp(c, ACCESS_WIDTH::HALFWORD);
+    default: return false;
+  }
+}
+
+// SWI 0x02 Halt, 0x04 IntrWait (r0 discard old flags, r1 mask) and 0x05 VBlankIntrWait. The flags come from
+// the word at 0x03007FF8 the game's irq handler ORs its IF bits into. Waiting halts with r15 back on the SWI,
+// the irq that ends the halt gets taken first, then the SWI looks at the flags again.
+bool ARM7TDMI::hle_wait(u8 number) {
+  static constexpr u32 BIOS_IF = 0x03007FF8;
+
+  if (number == 0x02) {
+    halted = true;
+    return true;
+  }
+
+  if (number == 0x05) {
+    regs.r[0] = 1;
+    regs.r[1] = 1;
+  }
+
+  const u32 address = regs.r[15] - (regs.CPSR.STATE_BIT == THUMB_MODE ? 4 : 8);
+  const u16 mask    = static_cast<u16>(regs.r[1]);
+  u16 flags         = bus->read16(BIOS_IF);
+
+  if (regs.r[0] != 0 && hle_wait_address != address) flags = static_cast<u16>(flags & ~mask);  // only new ones count, but not again after every wake up
+
+  bus->interrupt_control.IME.v = 1;
+
+  if (flags & mask) {
+    bus->write16(BIOS_IF, static_cast<u16>(flags & ~mask));
+    hle_wait_address = 0xFFFFFFFF;
+    return true;
+  }
+
+  bus->write16(BIOS_IF, flags);
+  hle_wait_address = address;
+  halted           = true;
+
+  regs.r[15] = address;
+  flush_pipeline();
+  return true;
+}
+
+bool ARM7TDMI::hle_swi(u8 number) {
+  if (!check_hle_bios && (number == 0x02 || number == 0x04 || number == 0x05)) return hle_wait(number);
+
+  const u64 start_cycles = cycles_elapsed;
+  const bool dry         = check_hle_bios;
+
+  hle_check.writes.clear();
+
+  HleCall call = {.bus = *bus, .dry = dry, .r = {regs.r[0], regs.r[1], regs.r[2], regs.r[3]}, .journal = &hle_check.writes};
+  const bool handled = run_call(call, number);
+
+  if (dry) {
+    cycles_elapsed = start_cycles;  // the BIOS is about to spend the real amount
+    if (!handled) return false;
+
+    hle_check.pending        = true;
+    hle_check.number         = number;
+    hle_check.return_address = regs.r[15] - (regs.CPSR.STATE_BIT == THUMB_MODE ? 2 : 4);
+    hle_check.state          = regs.CPSR.STATE_BIT;
+    hle_check.mode           = regs.CPSR.MODE_BIT;
+    hle_check.reg_mask       = call.reg_mask;
+    hle_check.regs           = call.r;
+    return false;
+  }
+
+  if (!handled) {
+    cycles_elapsed = start_cycles;
+
+    if (!bus->has_bios && !hle_unimplemented_warned[number]) {
+      hle_unimplemented_warned[number] = true;
+      cpu_logger->warn("SWI {:#04x} isn't handled without a BIOS, the built-in one returns straight away", number);
+    }
+    return false;
+  }
+
+  for (u8 i = 0; i < 4; i++) {
+    if (call.reg_mask & (1 << i)) regs.r[i] = call.r[i];
+  }
+
+  cycles_elapsed     = start_cycles + call.cost;
+  bus->bios_open_bus = 0xE3A02004;  // last opcode the BIOS fetches on its way out of a SWI
+  hle_calls++;
+  return true;
+}
+
+// Check mode, run between blocks. Once the BIOS is back at the instruction after the SWI, whatever the HLE
+// version would have left behind has to be there.
+void ARM7TDMI::hle_check_result() {
+  const u32 pc = regs.r[15] - (regs.CPSR.STATE_BIT == THUMB_MODE ? 4 : 8);
+  if (pc != hle_check.return_address || regs.CPSR.STATE_BIT != hle_check.state || regs.CPSR.MODE_BIT != hle_check.mode) return;
+
+  hle_check.pending = false;
+  hle_calls++;
+
+  bool match = true;
+
+  for (u8 i = 0; i < 4; i++) {
+    if (!(hle_check.reg_mask & (1 << i)) || regs.r[i] == hle_check.regs[i]) continue;
+
+    cpu_logger->warn("HLE SWI {:#04x}: r{} is {:#010x}, BIOS left {:#010x}", hle_check.number, i, hle_check.regs[i], regs.r[i]);
+    match = false;
+  }
+
+  const u64 saved_cycles = cycles_elapsed;
+  for (const HleWrite& w : hle_check.writes) {
+    u32 actual = 0;
+    switch (w.width) {
+      case ACCESS_WIDTH::BYTE: actual = bus->read8(w.address); break;
+      case ACCESS_WIDTH::HALFWORD: actual = bus->read16(w.address); break;
+      case ACCESS_WIDTH::WORD: actual = bus->read32(w.address); break;
+    }
+    if (actual == w.value) continue;
+
+    cpu_logger->warn("HLE SWI {:#04x}: wrote {:#x} to {:#010x}, BIOS left {:#x}", hle_check.number, w.value, w.address, actual);
+    match = false;
+    break;  // the first one is enough to go on
+  }
+  cycles_elapsed = saved_cycles;
+
+  if (!match) hle_mismatches++;
+}
@@ -0,0 +1,208 @@
+#include <algorithm>
+
+#include "bus.hpp"
+#include "core/cpu.hpp"
+#include "instructions/arm.hpp"
+#include "sched/sched.hpp"
+
+// Conservative, anything that can write r15 or switch state closes the block. run_block() checks for
+// flushes at runtime anyway, this just keeps blocks from running past the point they usually leave.
+static bool ends_block(FuncPtr handler, u32 opcode, CPU_MODE state) {
+  if (state == THUMB_MODE) {
+    if (handler == THUMB_CONDITIONAL_BRANCH || handler == THUMB_UNCONDITIONAL_BRANCH) return true;
+    if (handler == THUMB_BL_SUFFIX || handler == ARM_SOFTWARE_INTERRUPT) return true;
+    if (handler == THUMB_ADD_CMP_MOV_HI) return ((opcode >> 8) & 0b11) == 3 || (opcode & 0b10000111) == 0b10000111;  // BX, or Rd = r15
+    if (handler == THUMB_PUSH_POP) return (opcode & (1 << 11)) && (opcode & (1 << 8));                                // POP {.., pc}
+
+    return false;
+  }
+
+  if (handler == ARM_BRANCH_LINK || handler == ARM_BRANCH_EXCHANGE || handler == ARM_SOFTWARE_INTERRUPT) return true;
+  if (handler == ARM_PSR_TRANSFER) return true;                                        // may switch mode
+  if (handler == ARM_BLOCK_DATA_TRANSFER) return (opcode & (1 << 20)) && (opcode & (1 << 15));  // LDM {.., pc}
+
+  return ((opcode >> 12) & 0xF) == 15;  // Rd = r15
+}
+
+// A block that branches back to its own start and does nothing but read memory and work on registers. Whether an
+// iteration actually changes anything is left to check_idle_loop(), this only rules out side effects.
+static bool is_idle_loop(const ARM7TDMI::Block& block) {
+  if (block.length == 0 || block.length > ARM7TDMI::MAX_IDLE_LOOP_LENGTH) return false;
+
+  const u32 size = block.state == THUMB_MODE ? 2 : 4;
+
+  for (u8 i = 0; i < block.length; i++) {
+    const u32 op    = block.instrs[i].opcode;
+    const u32 addr  = block.start + (i * size);
+    const bool last = i == block.length - 1;
+
+    if (block.state == THUMB_MODE) {
+      const FuncPtr format = ARM7TDMI::thumb_decode(static_cast<u16>(op >> 6));
+
+      if (last) {
+        if (format == THUMB_CONDITIONAL_BRANCH) return addr + 4 + (static_cast<i8>(op & 0xFF) * 2) == block.start;
+        if (format == THUMB_UNCONDITIONAL_BRANCH) return addr + 4 + ((static_cast<i32>(op << 21) >> 21) * 2) == block.start;
+        return false;
+      }
+
+      if (format == THUMB_MOVE_SHIFTED_REG || format == THUMB_ADD_SUB || format == THUMB_MOV_CMP_ADD_SUB || format == THUMB_DATA_PROC) continue;
+      if (format == THUMB_ADD_CMP_MOV_HI || format == THUMB_LDR_PC_REL || format == THUMB_ADD_SP_PC) continue;
+      if (format == THUMB_WORD_BYTE_IMM_OFFSET || format == THUMB_WORD_BYTE_REG_OFFSET || format == THUMB_HALFWORD_IMM_OFFSET || format == THUMB_LOAD_STORE_SP_REL) {
+        if (op & (1 << 11)) continue;  // loads only
+      }
+      if (format == THUMB_SIGN_EXTENDED_LOAD_STORE_REG_OFFSET && ((op >> 10) & 0b11) != 0) continue;  // everything but STRH
+
+      return false;
+    }
+
+    const FuncPtr format = ARM7TDMI::arm_decode(((op & 0xff00000) >> 16) | ((op & 0xF0) >> 4));
+
+    if (last) {
+      if (format != ARM_BRANCH_LINK || (op & (1 << 24))) return false;  // B, not BL
+      return addr + 8 + ((static_cast<i32>(op << 8) >> 8) * 4) == block.start;
+    }
+
+    if (format == ARM_DATA_PROCESSING || format == ARM_MULTIPLY) continue;
+    if (format == ARM_SINGLE_DATA_TRANSFER || format == ARM_HALFWORD_LOAD_STORE || format == ARM_SIGNED_LOAD) {
+      if (op & (1 << 20)) continue;  // loads only
+    }
+
+    return false;
+  }
+
+  return false;
+}
+
+ARM7TDMI::Block* ARM7TDMI::get_block() {
+  const CPU_MODE state = regs.CPSR.STATE_BIT;
+  const u32 address    = regs.r[15] - (state == THUMB_MODE ? 4 : 8);  // r15 is 2 instructions ahead of execute
+
+  switch (static_cast<Bus::REGION>(address >> 24)) {
+    case Bus::REGION::BIOS:
+    case Bus::REGION::EWRAM:
+    case Bus::REGION::IWRAM:
+    case Bus::REGION::PAK_WS0_0:
+    case Bus::REGION::PAK_WS0_1:
+    case Bus::REGION::PAK_WS1_0:
+    case Bus::REGION::PAK_WS1_1:
+    case Bus::REGION::PAK_WS2_0: break;
+    default: return nullptr;
+  }
+
+  if (bus->get_read_page(address) == nullptr) return nullptr;
+
+  Block& block = block_cache[address | state];
+
+  if (block.opcode_count == 0 || block.start != address) {
+    compile_block(block, address, state);
+  } else if (block.code_page != Bus::NO_CODE_PAGE && bus->code_page_generation[block.code_page] != block.generation) {
+    compile_block(block, address, state);  // something wrote to the page since
+  }
+
+  return &block;
+}
+
+void ARM7TDMI::compile_block(Block& block, u32 address, CPU_MODE state) {
+  const u32 size               = state == THUMB_MODE ? 2 : 4;
+  const u32 page_end           = (address | ((1 << Bus::CODE_PAGE_SHIFT) - 1)) + 1;  // blocks never cross a code page
+  const Bus::FastmemPage* page = bus->get_read_page(address);
+
+  auto read_opcode = [&](u32 addr) -> u32 {
+    if (state == THUMB_MODE) return *(u16*)(page->ptr + (addr & page->mask));
+    return *(u32*)(page->ptr + (addr & page->mask));
+  };
+
+  block = {.start = address, .state = state, .code_page = Bus::get_code_page(address)};
+  if (block.code_page != Bus::NO_CODE_PAGE) block.generation = bus->code_page_generation[block.code_page];
+
+  for (u32 addr = address; addr < page_end && block.length < MAX_BLOCK_LENGTH; addr += size) {
+    u32 opcode      = read_opcode(addr);
+    FuncPtr handler = state == THUMB_MODE ? thumb_funcs[opcode >> 6] : arm_funcs[((opcode & 0xff00000) >> 16) | ((opcode & 0b11110000) >> 4)];
+
+    if (handler == nullptr) break;  // left to execute(), which reports it
+
+    block.instrs[block.length++] = {.handler = handler, .opcode = opcode, .cond = state == THUMB_MODE ? AL : static_cast<Condition>(opcode >> 28)};
+
+    if (ends_block(handler, opcode, state)) break;
+  }
+
+  // opcodes the pipeline fetches while the last 2 instructions execute
+  block.opcode_count = block.length;
+  for (u32 addr = address + (block.length * size); addr < page_end && block.opcode_count < block.length + 2; addr += size) {
+    block.instrs[block.opcode_count++].opcode = read_opcode(addr);
+  }
+
+  block.idle_loop = is_idle_loop(block);
+}
+
+// Same sequence as step(), with the fetch and decode taken from the block. Returns the amount of
+// instructions executed, 0 if the block couldn't be entered (step() takes over in that case).
+u32 ARM7TDMI::run_block(const Block& block, u64 target_cycle) {
+  const ACCESS_WIDTH fetch_width = block.state == THUMB_MODE ? ACCESS_WIDTH::HALFWORD : ACCESS_WIDTH::WORD;
+
+  for (u8 i = 0; i < block.length; i++) {
+    const CachedInstr& instr = block.instrs[i];
+
+    if (irq_ready()) return i;
+    if (pipeline.decode != instr.opcode) return i;  // prefetched before the block got decoded, memory changed in between
+
+    pipeline.execute = pipeline.decode;
+    pipeline.decode  = pipeline.fetch;
+
+    if (i + 2 < block.opcode_count) {
+      pipeline.fetch = block.instrs[i + 2].opcode;
+      cycles_elapsed += bus->get_access_cycles(regs.r[15], fetch_width, ACCESS_TYPE::NON_SEQUENTIAL);
+
+      if (regs.r[15] <= 0x3FFF) bus->bios_open_bus = pipeline.fetch;
+    } else {
+      pipeline.fetch = fetch(regs.r[15]);
+    }
+
+    flushed_pipeline = false;
+    if (block.state == THUMB_MODE || check_condition(instr.cond)) instr.handler(this, pipeline.execute);
+
+    regs.r[15] += regs.CPSR.STATE_BIT == THUMB_MODE ? 2 : 4;
+    instructions_executed++;
+
+    if (flushed_pipeline || regs.CPSR.STATE_BIT != block.state) return i + 1;
+    if (halted || bus->dma_requested || bus->scheduler->preempted || cycles_elapsed >= target_cycle) return i + 1;
+
+    // the block (or the code right after it) just got written to
+    if (block.code_page != Bus::NO_CODE_PAGE && bus->code_page_generation[block.code_page] != block.generation) return i + 1;
+  }
+
+  return block.length;
+}
+
+// Called after a block ran. Only sound for idle_loop blocks: no stores and no side effects, so with the same
+// memory and the same registers going in, an iteration always comes out the same.
+void ARM7TDMI::check_idle_loop(const Block& block, u64 target_cycle) {
+  const u32 pc = regs.r[15] - (block.state == THUMB_MODE ? 4 : 8);
+
+  if (pc != block.start || regs.CPSR.STATE_BIT != block.state) {  // left the loop, or got cut short
+    idle_snapshot.start = 0xFFFFFFFF;
+    return;
+  }
+
+  regs.sync_flags();
+
+  const bool same = idle_snapshot.start == block.start && idle_snapshot.cpsr == regs.CPSR.value && idle_snapshot.volatile_reads == bus->volatile_reads &&
+                    std::equal(idle_snapshot.r.begin(), idle_snapshot.r.end(), regs.r);
+
+  if (!same) {
+    idle_snapshot.start          = block.start;
+    idle_snapshot.cpsr           = regs.CPSR.value;
+    idle_snapshot.volatile_reads = bus->volatile_reads;
+    std::copy_n(regs.r, idle_snapshot.r.size(), idle_snapshot.r.begin());
+    return;
+  }
+
+  // the loop may have just started a timer it waits on, its overflow can sit ahead of the batch's target
+  const u64 skip_to = std::min(target_cycle, bus->scheduler->next_event_timestamp);
+
+  if (irq_ready() || cycles_elapsed >= skip_to) return;
+
+  idle_loops_skipped++;
+  idle_cycles_skipped += skip_to - cycles_elapsed;
+  cycles_elapsed = skip_to;
+}
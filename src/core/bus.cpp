@@ -17,8 +17,7 @@
 void Bus::request_interrupt(INTERRUPT_TYPE type) { interrupt_control.IF.v |= 1 << static_cast<u8>(type); }
 
 u8 Bus::read8(u32 address, ACCESS_TYPE access_type) {
-  cycles_elapsed += 1;
-  tick_timers(1);
+  cycles_elapsed += get_access_cycles(address, ACCESS_WIDTH::BYTE, access_type);
   // u8 word_alignment_offset = (address & 3);
 #ifdef SST_TEST_MODE
   // TODO: make a separate function for these
@@ -48,6 +47,10 @@ u8 Bus::read8(u32 address, ACCESS_TYPE access_type) {
 
   return address;
 #else
+  if (const FastmemPage* page = get_read_page(address)) {
+    return page->ptr[address & page->mask];
+  }
+
   u32 v = 0x0;
 
   switch (static_cast<REGION>(address >> 24)) {
@@ -101,8 +104,6 @@ u8 Bus::read8(u32 address, ACCESS_TYPE access_type) {
     case REGION::PAK_WS0_0:
     case REGION::PAK_WS0_1: {
       // game pak read (ws0)
-      cycles_elapsed += get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS0);
-      tick_timers(get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS0));
       v = pak->data.at(address - 0x08000000);
       break;
     }
@@ -110,8 +111,6 @@ u8 Bus::read8(u32 address, ACCESS_TYPE access_type) {
     case REGION::PAK_WS1_0:
     case REGION::PAK_WS1_1: {
       // game pak read (ws1)
-      cycles_elapsed += get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS1);
-      tick_timers(get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS1));
       v = pak->data.at(address - 0x0A000000);
       break;
     }
@@ -119,8 +118,6 @@ u8 Bus::read8(u32 address, ACCESS_TYPE access_type) {
     case REGION::PAK_WS2_0:
     case REGION::PAK_WS2_1: {
       // game pak read (ws2)
-      cycles_elapsed += get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS2);
-      tick_timers(get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS2));
       v = pak->data[address - 0x0C000000];
       break;
     }
@@ -148,8 +145,7 @@ u8 Bus::read8(u32 address, ACCESS_TYPE access_type) {
 #endif
 };
 u16 Bus::read16(u32 address, ACCESS_TYPE access_type) {
-  cycles_elapsed += 1;
-  tick_timers(1);
+  cycles_elapsed += get_access_cycles(address, ACCESS_WIDTH::HALFWORD, access_type);
   u32 _address = address;
   // u8 misaligned_by         = (address & 1) * 8;
   u8 word_alignment_offset = (address & 3);
@@ -178,6 +174,10 @@ u16 Bus::read16(u32 address, ACCESS_TYPE access_type) {
   return address;
 
 #else
+  if (const FastmemPage* page = get_read_page(address)) {
+    return *(u16*)(page->ptr + (address & page->mask));
+  }
+
   // fmt::println("[R16] {:#010x}", address);
   u32 v = 0;
   switch ((REGION)(address >> 24)) {
@@ -229,15 +229,11 @@ u16 Bus::read16(u32 address, ACCESS_TYPE access_type) {
     }
 
     case REGION::EWRAM: {
-      cycles_elapsed += 2;  // 3/3/6 -- mem access already accounts for 1
-      tick_timers(2);
       v = *(u16*)(&EWRAM[address % 0x40000]);
       break;
     }
 
     case REGION::IWRAM: {
-      cycles_elapsed += 1;
-      tick_timers(1);
       v = *(u16*)(&IWRAM[address % 0x8000]);
       break;
     }
@@ -267,8 +263,6 @@ u16 Bus::read16(u32 address, ACCESS_TYPE access_type) {
     case REGION::PAK_WS0_0:
     case REGION::PAK_WS0_1: {
       // game pak read (ws0)
-      cycles_elapsed += get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS0);
-      tick_timers(get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS0));
       v = *(uint16_t*)(&pak->data[address - 0x08000000]);
       break;
     }
@@ -276,8 +270,6 @@ u16 Bus::read16(u32 address, ACCESS_TYPE access_type) {
     case REGION::PAK_WS1_0:
     case REGION::PAK_WS1_1: {
       // game pak read (ws1)
-      cycles_elapsed += get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS1);
-      tick_timers(get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS1));
       v = *(u16*)(&pak->data[address - 0x0A000000]);
       break;
     }
@@ -287,8 +279,6 @@ u16 Bus::read16(u32 address, ACCESS_TYPE access_type) {
       if(address >= 0x0d000000 && pak->eeprom.bits_to_read != 0) return pak->eeprom.handle_read();
 
       // game pak read (ws2);
-      cycles_elapsed += get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS2);
-      tick_timers(get_rom_cycles_by_waitstate(access_type, WAITSTATE::WS2));
       v = *(u16*)(&pak->data[address - 0x0C000000]);
       break;
     }
@@ -312,9 +302,8 @@ u16 Bus::read16(u32 address, ACCESS_TYPE access_type) {
 
 #endif
 };
-u32 Bus::read32(u32 address, [[gnu::unused]] ACCESS_TYPE access_type) {
-  cycles_elapsed += 1;
-  tick_timers(1);
+u32 Bus::read32(u32 address, ACCESS_TYPE access_type) {
+  cycles_elapsed += get_access_cycles(address, ACCESS_WIDTH::WORD, access_type);
 
   // Scheduler::step(1);
   u32 _address = address;
@@ -341,6 +330,9 @@ u32 Bus::read32(u32 address, [[gnu::unused]] ACCESS_TYPE access_type) {
   return address;
 
 #else
+  if (const FastmemPage* page = get_read_page(address)) {
+    return *(u32*)(page->ptr + (address & page->mask));
+  }
 
   // SPDLOG_DEBUG("[R32] {:#010x}", address);
   u32 v = 0;
@@ -358,9 +350,6 @@ u32 Bus::read32(u32 address, [[gnu::unused]] ACCESS_TYPE access_type) {
     }
 
     case REGION::EWRAM: {
-      cycles_elapsed += 4;
-      tick_timers(4);
-      // get_wram_waitstates();
       v = *(u32*)(&EWRAM[address % 0x40000]);
       break;
     }
@@ -398,35 +387,18 @@ u32 Bus::read32(u32 address, [[gnu::unused]] ACCESS_TYPE access_type) {
 
     case REGION::PAK_WS0_0:
     case REGION::PAK_WS0_1: {
-      cycles_elapsed += get_rom_cycles_by_waitstate(ACCESS_TYPE::NON_SEQUENTIAL, WAITSTATE::WS0);
-      cycles_elapsed += get_rom_cycles_by_waitstate(ACCESS_TYPE::SEQUENTIAL, WAITSTATE::WS0);
-      tick_timers(get_rom_cycles_by_waitstate(ACCESS_TYPE::NON_SEQUENTIAL, WAITSTATE::WS0));
-      tick_timers(get_rom_cycles_by_waitstate(ACCESS_TYPE::SEQUENTIAL, WAITSTATE::WS0));
-
       v = *(uint32_t*)(&pak->data[address - 0x08000000]);
       break;
     }
 
     case REGION::PAK_WS1_0:
     case REGION::PAK_WS1_1: {
-      cycles_elapsed += get_rom_cycles_by_waitstate(ACCESS_TYPE::NON_SEQUENTIAL, WAITSTATE::WS1);
-      cycles_elapsed += get_rom_cycles_by_waitstate(ACCESS_TYPE::SEQUENTIAL, WAITSTATE::WS1);
-
-      tick_timers(get_rom_cycles_by_waitstate(ACCESS_TYPE::NON_SEQUENTIAL, WAITSTATE::WS1));
-      tick_timers(get_rom_cycles_by_waitstate(ACCESS_TYPE::SEQUENTIAL, WAITSTATE::WS1));
-
       v = *(uint32_t*)(&pak->data[address - 0x0A000000]);
       break;
     }
 
     case REGION::PAK_WS2_0:
     case REGION::PAK_WS2_1: {
-      cycles_elapsed += get_rom_cycles_by_waitstate(ACCESS_TYPE::NON_SEQUENTIAL, WAITSTATE::WS2);
-      cycles_elapsed += get_rom_cycles_by_waitstate(ACCESS_TYPE::SEQUENTIAL, WAITSTATE::WS2);
-
-      tick_timers(get_rom_cycles_by_waitstate(ACCESS_TYPE::NON_SEQUENTIAL, WAITSTATE::WS2));
-      tick_timers(get_rom_cycles_by_waitstate(ACCESS_TYPE::SEQUENTIAL, WAITSTATE::WS2));
-
       v = *(u32*)(&pak->data[address - 0x0C000000]);
       break;
     }
@@ -459,16 +431,24 @@ void Bus::write8(u32 address, u8 value) {
   }
   return;
 #else
-  cycles_elapsed += 1;
-  tick_timers(1);
+  cycles_elapsed += get_access_cycles(address, ACCESS_WIDTH::BYTE, ACCESS_TYPE::NON_SEQUENTIAL);
+
+  if (const FastmemPage* page = get_write_page(address); page && !(page->flags & (PAGE_SIDE_EFFECTS | PAGE_NO_BYTE_WRITES))) {
+    page->ptr[address & page->mask] = value;
+    if (page->flags & PAGE_CODE) note_code_write(address);
+    return;
+  }
+
   switch ((REGION)(address >> 24)) {
     case REGION::EWRAM: {
       EWRAM.at(address % 0x40000) = value;
+      note_code_write(address);
       break;
     }
 
     case REGION::IWRAM: {
       IWRAM.at(address % 0x8000) = value;
+      note_code_write(address);
       break;
     }
 
@@ -479,8 +459,8 @@ void Bus::write8(u32 address, u8 value) {
     }
 
     case REGION::BG_OBJ_PALETTE: {
-      fmt::println("{:#010X} -- {:#010X}", address, value);
       *(uint16_t*)&ppu->PALETTE_RAM.at((address % 0x400) & ~1) = value * 0x101;
+      ppu->mark_palette_dirty(address % 0x400);
 
       return;
     }
@@ -494,6 +474,7 @@ void Bus::write8(u32 address, u8 value) {
 
       // fmt::println("value:{:#04X}", value);
       *(uint16_t*)&ppu->VRAM.at(max_addr & ~1) = value * 0x101;
+      ppu->mark_vram_dirty(static_cast<u32>(max_addr));
       return;
     }
 
@@ -524,8 +505,7 @@ void Bus::write16(u32 address, u16 value) {
   u32 _address = address;
   (void)_address;
   address = align(address, HALFWORD);
-  cycles_elapsed += 1;
-  tick_timers(1);
+  cycles_elapsed += get_access_cycles(address, ACCESS_WIDTH::HALFWORD, ACCESS_TYPE::NON_SEQUENTIAL);
 #ifdef SST_TEST_MODE
   bus_logger->debug("write [16] at {:#010x} -> {:#010x}", address, value);
   fmt::println("write [16] at {:#010x} -> {:#010x}", address, value);
@@ -545,16 +525,23 @@ void Bus::write16(u32 address, u16 value) {
   exit(-1);
   return;
 #else
+  if (const FastmemPage* page = get_write_page(address)) {
+    *(u16*)(page->ptr + (address & page->mask)) = value;
+    if (page->flags & PAGE_CODE) note_code_write(address);
+    if (page->flags & PAGE_SIDE_EFFECTS) handle_write_side_effects(address);
+    return;
+  }
 
   switch ((REGION)(address >> 24)) {
     case REGION::EWRAM: {
       *(uint16_t*)(&EWRAM[address % 0x40000]) = value;
+      note_code_write(address);
       break;
     }
 
     case REGION::IWRAM: {
       *(uint16_t*)(&IWRAM[address % 0x8000]) = value;
-
+      note_code_write(address);
       break;
     }
 
@@ -569,6 +556,7 @@ void Bus::write16(u32 address, u16 value) {
     case REGION::BG_OBJ_PALETTE: {
       // BG/OBJ Palette RAM
       *(uint16_t*)(&ppu->PALETTE_RAM[address % 0x400]) = value;
+      ppu->mark_palette_dirty(address % 0x400);
       break;
     }
 
@@ -580,13 +568,14 @@ void Bus::write16(u32 address, u16 value) {
       if (norm_addr >= 0x18000) norm_addr -= 0x8000u;
 
       *(uint16_t*)(&ppu->VRAM.at(norm_addr)) = value;
+      ppu->mark_vram_dirty(static_cast<u32>(norm_addr));
       break;
     }
 
     case REGION::OAM: {
       // OAM
       *(uint16_t*)(&OAM.at(address % 0x400)) = value;
-      ppu->state.oam_changed                 = true;
+      ppu->mark_oam_dirty(address % 0x400);
       break;
     }
 
@@ -632,8 +621,7 @@ void Bus::write32(u32 address, u32 value) {
   u32 _address = address;
   (void)_address;
   address = align(address, WORD);
-  cycles_elapsed += 1;
-  tick_timers(1);
+  cycles_elapsed += get_access_cycles(address, ACCESS_WIDTH::WORD, ACCESS_TYPE::NON_SEQUENTIAL);
 
 #ifdef SST_TEST_MODE
   fmt::println("write [32] at {:#010x} -> {:#010x}", address, value);
@@ -655,15 +643,23 @@ void Bus::write32(u32 address, u32 value) {
 
   return;
 #else
+  if (const FastmemPage* page = get_write_page(address)) {
+    *(u32*)(page->ptr + (address & page->mask)) = value;
+    if (page->flags & PAGE_CODE) note_code_write(address);
+    if (page->flags & PAGE_SIDE_EFFECTS) handle_write_side_effects(address);
+    return;
+  }
 
   switch ((REGION)(address >> 24)) {
     case REGION::EWRAM: {
       *(uint32_t*)(&EWRAM.at(address % 0x40000)) = value;
+      note_code_write(address);
       break;
     }
 
     case REGION::IWRAM: {
       *(uint32_t*)(&IWRAM.at(address % 0x8000)) = value;
+      note_code_write(address);
       break;
     }
 
@@ -677,6 +673,7 @@ void Bus::write32(u32 address, u32 value) {
 
     case REGION::BG_OBJ_PALETTE: {
       *(uint32_t*)(&ppu->PALETTE_RAM[(address % 0x400)]) = value;
+      ppu->mark_palette_dirty(address % 0x400);
       break;
     }
 
@@ -686,12 +683,13 @@ void Bus::write32(u32 address, u32 value) {
       if (norm_addr >= 0x18000) norm_addr -= 0x8000u;
 
       *(uint32_t*)(&ppu->VRAM.at(norm_addr)) = value;
+      ppu->mark_vram_dirty(static_cast<u32>(norm_addr));
       break;
     }
 
     case REGION::OAM: {
       *(uint32_t*)(&OAM[(address % 0x400)]) = value;
-      ppu->state.oam_changed                = true;
+      ppu->mark_oam_dirty(address % 0x400);
       break;
     }
 
@@ -933,8 +931,9 @@ u8 Bus::io_read(u32 address) {
 
     case TM0CNT_L:
     case TM0CNT_L + 1: {
-      retval = read_byte(tm0->counter, address % 2);
-      // fmt::println("retval: {}", tm0->counter);
+      u16 counter = tm0->get_counter();
+      retval      = read_byte(counter, address % 2);
+      volatile_reads++;
       break;
     }
     case TM0CNT_H:
@@ -945,12 +944,9 @@ u8 Bus::io_read(u32 address) {
 
     case TM1CNT_L:
     case TM1CNT_L + 1: {
-      // retval = read_byte(tm1->counter, address % 2);
-
-      // u16 ticks = (cycles_elapsed - tm1->start_time + cycles_elapsed) / tm1->get_divider_val();
-
-      // tm1->counter = 0;
-      retval = read_byte(tm1->counter, address % 2);
+      u16 counter = tm1->get_counter();
+      retval      = read_byte(counter, address % 2);
+      volatile_reads++;
       break;
     }
     case TM1CNT_H:
@@ -961,8 +957,9 @@ u8 Bus::io_read(u32 address) {
 
     case TM2CNT_L:
     case TM2CNT_L + 1: {
-      tm2->counter = 0;
-      retval       = read_byte(tm2->counter, address % 2);
+      u16 counter = tm2->get_counter();
+      retval      = read_byte(counter, address % 2);
+      volatile_reads++;
       break;
     }
     case TM2CNT_H:
@@ -973,13 +970,14 @@ u8 Bus::io_read(u32 address) {
 
     case TM3CNT_L:
     case TM3CNT_L + 1: {
-      tm3->counter = 0;
-      retval       = read_byte(tm3->counter, address % 2);
+      u16 counter = tm3->get_counter();
+      retval      = read_byte(counter, address % 2);
+      volatile_reads++;
       break;
     }
     case TM3CNT_H:
     case TM3CNT_H + 1: {
-      retval = read_byte(tm0->ctrl.v, address % 2);
+      retval = read_byte(tm3->ctrl.v, address % 2);
       break;
     }
 
@@ -1053,9 +1051,14 @@ u8 Bus::io_read(u32 address) {
     case UNKNOWN302:
     case UNKNOWN302 + 1: return 0x00;
 
-    case POSTFLG:
+    case POSTFLG: {
+      retval = system_control.POSTFLG;
+      break;
+    }
+    case HALTCNT: {
+      retval = system_control.HALTCNT;
       break;
-      // case HALTCNT: break;
+    }
 
     default: {
       // fmt::println("misaligned/partial read {:#08x} - [{}]", address, get_label(address));
@@ -1221,6 +1224,7 @@ void Bus::io_write(u32 address, u8 value) {
     case BG2X + 2:
     case BG2X + 3: {
       set_byte(ppu->display_fields.BG2X.v, address % 0x4, value);
+      ppu->latched_bg2x = PPU::sign_extend_reference(ppu->display_fields.BG2X.v);
       break;
     }
     case BG2Y:
@@ -1228,6 +1232,7 @@ void Bus::io_write(u32 address, u8 value) {
     case BG2Y + 2:
     case BG2Y + 3: {
       set_byte(ppu->display_fields.BG2Y.v, address % 0x4, value);
+      ppu->latched_bg2y = PPU::sign_extend_reference(ppu->display_fields.BG2Y.v);
       break;
     }
 
@@ -1236,6 +1241,7 @@ void Bus::io_write(u32 address, u8 value) {
     case BG3X + 2:
     case BG3X + 3: {
       set_byte(ppu->display_fields.BG3X.v, address % 0x4, value);
+      ppu->latched_bg3x = PPU::sign_extend_reference(ppu->display_fields.BG3X.v);
       break;
     }
     case BG3Y:
@@ -1243,6 +1249,7 @@ void Bus::io_write(u32 address, u8 value) {
     case BG3Y + 2:
     case BG3Y + 3: {
       set_byte(ppu->display_fields.BG3Y.v, address % 0x4, value);
+      ppu->latched_bg3y = PPU::sign_extend_reference(ppu->display_fields.BG3Y.v);
       break;
     }
 
@@ -1300,6 +1307,7 @@ void Bus::io_write(u32 address, u8 value) {
     case BLDY:
     case BLDY + 1: {
       set_byte(ppu->display_fields.BLDY.v, address % 0x2, value);
+      ppu->set_brightness(ppu->display_fields.BLDY.EVY_COEFFICIENT);
       break;
     }
     case SOUND1CNT_L:
@@ -1443,6 +1451,7 @@ void Bus::io_write(u32 address, u8 value) {
       set_byte(system_control.WAITCNT.v, address % 4, value);
 
       system_control.WAITCNT.v &= 0b1101111111111111;
+      rebuild_cycle_table();
       break;
     }
 
@@ -1509,6 +1518,7 @@ void Bus::io_write(u32 address, u8 value) {
         ch0->internal_src       = ch0->src;
         ch0->internal_dst       = ch0->dst;
         ch0->internal_word_size = ch0->dmacnt_l.word_count;
+        dma_requested           = true;
       }
       break;
     }
@@ -1538,6 +1548,7 @@ void Bus::io_write(u32 address, u8 value) {
         ch1->internal_src       = ch1->src;
         ch1->internal_dst       = ch1->dst;
         ch1->internal_word_size = ch1->dmacnt_l.word_count;
+        dma_requested           = true;
       }
 
       break;
@@ -1569,6 +1580,7 @@ void Bus::io_write(u32 address, u8 value) {
         ch2->internal_src       = ch2->src;
         ch2->internal_dst       = ch2->dst;
         ch2->internal_word_size = ch2->dmacnt_l.word_count;
+        dma_requested           = true;
       }
 
       break;
@@ -1598,6 +1610,7 @@ void Bus::io_write(u32 address, u8 value) {
         ch3->internal_src       = ch3->src;
         ch3->internal_dst       = ch3->dst;
         ch3->internal_word_size = ch3->dmacnt_l.word_count;
+        dma_requested           = true;
       }
 
       break;
@@ -1609,15 +1622,7 @@ void Bus::io_write(u32 address, u8 value) {
     }
     case TM0CNT_H:
     case TM0CNT_H + 1: {
-      bool stopped = !tm0->ctrl.timer_start_stop;
-      set_byte(tm0->ctrl.v, address % 2, value);
-      bool started = tm0->ctrl.timer_start_stop;
-
-      if (stopped && started) {  // Timer goes from OFF TO ON (0->1)
-        tm0->reload_counter();
-        tm0->start_time = cycles_elapsed + 2;
-        fmt::println("updated start time to value: {}", tm0->start_time);
-      }
+      tm0->write_control(address % 2, value);
       break;
     }
     case TM1CNT_L:
@@ -1627,32 +1632,17 @@ void Bus::io_write(u32 address, u8 value) {
     }
     case TM1CNT_H:
     case TM1CNT_H + 1: {
-      bool stopped = tm1->ctrl.timer_start_stop == false;
-      set_byte(tm1->ctrl.v, address % 2, value);
-      bool started = tm1->ctrl.timer_start_stop;
-
-      if (stopped && started) {
-        tm1->reload_counter();
-      }
+      tm1->write_control(address % 2, value);
       break;
     }
     case TM2CNT_L:
     case TM2CNT_L + 1: {
       set_byte(tm2->reload_value, address % 2, value);
-
       break;
     }
     case TM2CNT_H:
     case TM2CNT_H + 1: {
-      bool stopped = tm2->ctrl.timer_start_stop == false;
-      set_byte(tm2->ctrl.v, address % 2, value);
-      bool started = tm2->ctrl.timer_start_stop;
-      // tm2->ctrl.v &= 0x7F;
-
-      if (stopped && started) {
-        tm2->reload_counter();
-        // Scheduler::Schedule(Scheduler::EventType::TIMER2_START, cycles_elapsed + 2);
-      }
+      tm2->write_control(address % 2, value);
       break;
     }
     case TM3CNT_L:
@@ -1662,17 +1652,7 @@ void Bus::io_write(u32 address, u8 value) {
     }
     case TM3CNT_H:
     case TM3CNT_H + 1: {
-      bool stopped = tm3->ctrl.timer_start_stop == false;
-      set_byte(tm3->ctrl.v, address % 2, value);
-      bool started = tm3->ctrl.timer_start_stop;
-
-      if (stopped && started) {
-        tm3->reload_counter();
-        // tm3->ctrl.v &= 0x7F;
-
-        // Scheduler::Schedule(Scheduler::EventType::TIMER3_START, cycles_elapsed + 2);
-      }
-
+      tm3->write_control(address % 2, value);
       break;
     }
     case SIODATA32: break;
@@ -1719,6 +1699,9 @@ void Bus::io_write(u32 address, u8 value) {
     }
     case HALTCNT: {
       set_byte(system_control.HALTCNT, 0, value);
+
+      // bit 7 selects STOP, which needs keypad/serial wake-up -- only HALT is implemented
+      if (!system_control.halt) cpu->halted = true;
       break;
     }
 
@@ -1727,6 +1710,7 @@ void Bus::io_write(u32 address, u8 value) {
     case 0x4000800 + 2:
     case 0x4000800 + 3: {
       set_byte(system_control.IMC, address % 4, value);
+      rebuild_cycle_table();
       break;
     }
 
@@ -1736,70 +1720,140 @@ void Bus::io_write(u32 address, u8 value) {
   }
 #endif
 }
-u8 Bus::get_rom_cycles_by_waitstate(const ACCESS_TYPE access_type, const WAITSTATE ws) {
-  switch (access_type) {
-    case ACCESS_TYPE::SEQUENTIAL: {
-      switch (ws) {
-        case WAITSTATE::WS0: {
-          switch (system_control.WAITCNT.WS0_SECOND_ACCESS) {
-            case 0: return 2;
-            case 1: return 1;
-          }
-          break;
-        }
-        case WAITSTATE::WS1: {
-          switch (system_control.WAITCNT.WS1_SECOND_ACCESS) {
-            case 0: return 4;
-            case 1: return 1;
-          }
-          break;
-        }
-        case WAITSTATE::WS2: {
-          switch (system_control.WAITCNT.WS2_SECOND_ACCESS) {
-            case 0: return 8;
-            case 1: return 1;
-          }
-          break;
-        }
-      }
-      break;
-    }
-    case ACCESS_TYPE::NON_SEQUENTIAL: {
-      switch (ws) {
-        case WAITSTATE::WS0: {
-          switch (system_control.WAITCNT.WS0_FIRST_ACCESS) {
-            case 0: return 4;
-            case 1: return 3;
-            case 2: return 2;
-            case 3: return 8;
-          }
-          break;
-        }
-        case WAITSTATE::WS1: {
-          switch (system_control.WAITCNT.WS1_FIRST_ACCESS) {
-            case 0: return 4;
-            case 1: return 3;
-            case 2: return 2;
-            case 3: return 8;
-          }
-          break;
-        }
-        case WAITSTATE::WS2: {
-          switch (system_control.WAITCNT.WS2_FIRST_ACCESS) {
-            case 0: return 4;
-            case 1: return 3;
-            case 2: return 2;
-            case 3: return 8;
-          }
-          break;
-        }
-      }
-      break;
+// Cycles per access, including the 1 cycle every access costs. Rebuilt on WAITCNT/internal memory control writes
+// so an access only does a single indexed load.
+void Bus::rebuild_cycle_table() {
+  static constexpr std::array<u8, 4> FIRST_ACCESS = {4, 3, 2, 8};
+
+  const std::array<u8, 3> rom_nonseq = {
+      FIRST_ACCESS[system_control.WAITCNT.WS0_FIRST_ACCESS],
+      FIRST_ACCESS[system_control.WAITCNT.WS1_FIRST_ACCESS],
+      FIRST_ACCESS[system_control.WAITCNT.WS2_FIRST_ACCESS],
+  };
+  const std::array<u8, 3> rom_seq = {
+      static_cast<u8>(system_control.WAITCNT.WS0_SECOND_ACCESS ? 1 : 2),
+      static_cast<u8>(system_control.WAITCNT.WS1_SECOND_ACCESS ? 1 : 4),
+      static_cast<u8>(system_control.WAITCNT.WS2_SECOND_ACCESS ? 1 : 8),
+  };
+
+  auto set = [&](REGION region, u32 half_n, u32 half_s, u32 word_n, u32 word_s) {
+    auto& entry = access_cycles[static_cast<u8>(region)];
+
+    entry[static_cast<u8>(ACCESS_WIDTH::BYTE)]     = {static_cast<u8>(half_s), static_cast<u8>(half_n)};
+    entry[static_cast<u8>(ACCESS_WIDTH::HALFWORD)] = {static_cast<u8>(half_s), static_cast<u8>(half_n)};
+    entry[static_cast<u8>(ACCESS_WIDTH::WORD)]     = {static_cast<u8>(word_s), static_cast<u8>(word_n)};
+  };
+
+  for (auto& entry : access_cycles) {
+    for (auto& width : entry) width = {1, 1};
+  }
+
+  // 16 bit bus regions, a 32 bit access is 2 halfword accesses
+  const u32 ewram = 1 + (15 - system_control.wait_control_wram);
+  set(REGION::EWRAM, ewram, ewram, ewram * 2, ewram * 2);
+  set(REGION::BG_OBJ_PALETTE, 1, 1, 2, 2);
+  set(REGION::VRAM, 1, 1, 2, 2);
+
+  // game pak, 32 bit is a halfword access followed by a sequential one
+  constexpr std::array<std::array<REGION, 2>, 3> PAK_REGIONS = {{
+      {REGION::PAK_WS0_0, REGION::PAK_WS0_1},
+      {REGION::PAK_WS1_0, REGION::PAK_WS1_1},
+      {REGION::PAK_WS2_0, REGION::PAK_WS2_1},
+  }};
+
+  for (size_t ws = 0; ws < 3; ws++) {
+    const u32 n = 1 + rom_nonseq[ws];
+    const u32 s = 1 + rom_seq[ws];
+
+    for (REGION region : PAK_REGIONS[ws]) set(region, n, s, n + s, s * 2);
+  }
+
+  // SRAM has an 8 bit bus, wider accesses are still only a single byte access
+  const u32 sram = 1 + FIRST_ACCESS[system_control.WAITCNT.SRAM_WAIT_CONTROL];
+  set(REGION::SRAM_0, sram, sram, sram, sram);
+  set(REGION::SRAM_1, sram, sram, sram, sram);
+}
+
+// Points every page in [base, end) at memory, mirroring it when the region is smaller than [base, end).
+void Bus::map_fastmem_region(u32 base, u32 end, u8* memory, u32 size, bool readable, bool writable, u8 flags) {
+  for (u32 addr = base; addr < end; addr += PAGE_SIZE) {
+    FastmemPage page = {};
+
+    if (size >= PAGE_SIZE) {
+      page = {.ptr = memory + ((addr - base) % size), .mask = PAGE_SIZE - 1, .flags = flags};
+    } else {
+      page = {.ptr = memory, .mask = size - 1, .flags = flags};
     }
-    default: {
+
+    if (readable) read_pages[addr >> PAGE_SHIFT] = page;
+    if (writable) write_pages[addr >> PAGE_SHIFT] = page;
+  }
+}
+
+// needs ppu/pak to be attached, called once the AGB has wired the devices up
+void Bus::map_fastmem_pages() {
+  std::ranges::fill(read_pages, FastmemPage{});
+  std::ranges::fill(write_pages, FastmemPage{});
+
+  map_fastmem_region(0x02000000, 0x03000000, EWRAM.data(), 0x40000, true, true, PAGE_CODE);
+  map_fastmem_region(0x03000000, 0x04000000, IWRAM.data(), 0x8000, true, true, PAGE_CODE);
+  map_fastmem_region(0x05000000, 0x06000000, ppu->PALETTE_RAM.data(), 0x400, true, true, PAGE_SIDE_EFFECTS | PAGE_NO_BYTE_WRITES);
+  map_fastmem_region(0x07000000, 0x08000000, OAM.data(), 0x400, true, true, PAGE_SIDE_EFFECTS | PAGE_NO_BYTE_WRITES);
+
+  // VRAM is 96K mirrored in 128K steps, with 0x18000-0x1FFFF folding back onto 0x10000-0x17FFF (OBJ tiles)
+  for (u32 addr = 0x06000000; addr < 0x07000000; addr += PAGE_SIZE) {
+    u32 norm_addr = addr & 0x1FFFF;
+    if (norm_addr >= 0x18000) norm_addr -= 0x8000;
+
+    FastmemPage page = {.ptr = ppu->VRAM.data() + norm_addr, .mask = PAGE_SIZE - 1, .flags = PAGE_SIDE_EFFECTS | PAGE_NO_BYTE_WRITES};
+
+    read_pages[addr >> PAGE_SHIFT]  = page;
+    write_pages[addr >> PAGE_SHIFT] = page;
+  }
+
+  // ROM is read only, writes go to the EEPROM/GPIO handlers. 0x0D000000+ stays on the slow path for EEPROM reads
+  map_fastmem_region(0x08000000, 0x0A000000, pak->data.data(), MAX_ROM_SIZE, true, false);
+  map_fastmem_region(0x0A000000, 0x0C000000, pak->data.data(), MAX_ROM_SIZE, true, false);
+  map_fastmem_region(0x0C000000, 0x0D000000, pak->data.data(), MAX_ROM_SIZE, true, false);
+
+  set_bios_readable(cpu->regs.r[15] <= 0x3FFF);
+}
+
+void Bus::load_builtin_bios() {
+  static constexpr std::array<std::pair<u32, u32>, 10> code = {{
+      {0x000, 0xE3A0F302},  // reset: mov pc, #0x08000000
+      {0x008, 0xE1B0F00E},  // swi: movs pc, lr
+      {0x018, 0xEA000042},  // irq: b 0x128
+      {0x128, 0xE92D500F},  // stmfd sp!, {r0-r3, r12, lr}
+      {0x12C, 0xE3A00301},  // mov r0, #0x04000000
+      {0x130, 0xE28FE000},  // add lr, pc, #0
+      {0x134, 0xE510F004},  // ldr pc, [r0, #-4]  (handler the game put at 0x03FFFFFC)
+      {0x138, 0xE8BD500F},  // ldmfd sp!, {r0-r3, r12, lr}
+      {0x13C, 0xE25EF004},  // subs pc, lr, #4
+      {0x140, 0xE1B0F00E},  // movs pc, lr
+  }};
+
+  std::fill(BIOS.begin(), BIOS.end(), 0);
+  for (const auto& [address, opcode] : code) *(u32*)(&BIOS[address]) = opcode;
+}
+
+// BIOS is only readable while executing from it, the page is swapped whenever the pipeline gets flushed
+void Bus::set_bios_readable(bool readable) {
+  read_pages[0] = readable ? FastmemPage{.ptr = BIOS.data(), .mask = PAGE_SIZE - 1, .flags = 0} : FastmemPage{};
+}
+
+void Bus::handle_write_side_effects(u32 address) {
+  switch (static_cast<REGION>(address >> 24)) {
+    case REGION::VRAM: {
+      u32 norm_addr = address & 0x1FFFFu;
+      if (norm_addr >= 0x18000) norm_addr -= 0x8000u;
+
+      ppu->mark_vram_dirty(norm_addr);
+      ppu->state.vram_changed = true;
       break;
     }
+    case REGION::OAM: ppu->mark_oam_dirty(address % 0x400); break;
+    case REGION::BG_OBJ_PALETTE: ppu->mark_palette_dirty(address % 0x400); break;
+    default: break;
   }
-  return 255;
 }
-u8 Bus::get_wram_waitstates() { return 1 + (15 - system_control.wait_control_wram); }
@@ -0,0 +1,285 @@
+#include "compositor.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if BASS_COMPOSITOR_X64
+#include <immintrin.h>
+#endif
+
+// below any BG, a transparent pixel (key | 0xFF) never gets above it
+static constexpr u32 BACKDROP_KEY = (4 << 3) | LAYER_BACKDROP;
+static constexpr u32 NO_KEY       = 0xFF;
+
+static void composite_scalar(const LayerLines& layers, const u8* ids, u32 count, u32 backdrop, CompositeLine& out) {
+  for (u32 x = 0; x < LINE_WIDTH; x++) {
+    u32 top_key      = BACKDROP_KEY;
+    u32 bottom_key   = NO_KEY;
+    u32 top_color    = backdrop;
+    u32 bottom_color = backdrop;
+
+    for (u32 i = 0; i < count; i++) {
+      const LayerLine& layer = layers[ids[i]];
+      if (!layer.opaque[x]) continue;
+
+      const u32 key = (layer.prio[x] << 3) | ids[i];
+
+      if (key < top_key) {
+        bottom_key   = top_key;
+        bottom_color = top_color;
+        top_key      = key;
+        top_color    = layer.color[x];
+      } else if (key < bottom_key) {
+        bottom_key   = key;
+        bottom_color = layer.color[x];
+      }
+    }
+
+    out.top_color[x]    = top_color;
+    out.bottom_color[x] = bottom_color;
+    out.top_layer[x]    = static_cast<u8>(top_key & 7);
+    out.bottom_layer[x] = static_cast<u8>(bottom_key & 7);
+  }
+}
+
+u16 adjust_brightness(u16 color, u32 evy, bool increase) {
+  u16 adjusted = 0;
+
+  for (u32 shift = 0; shift < 15; shift += 5) {
+    u32 i = (color >> shift) & 0x1F;
+    i     = increase ? i + (((31 - i) * evy) >> 4) : i - ((i * evy) >> 4);
+
+    adjusted |= static_cast<u16>(i << shift);
+  }
+
+  return adjusted;
+}
+
+static u32 alpha_blend(u32 top, u32 bottom, u32 eva, u32 evb) {
+  u32 color = 0;
+
+  for (u32 shift = 0; shift < 15; shift += 5) {
+    const u32 t = (top >> shift) & 0x1F;
+    const u32 b = (bottom >> shift) & 0x1F;
+
+    color |= std::min(31u, ((t * eva) + (b * evb)) >> 4) << shift;
+  }
+
+  return color;
+}
+
+static u32 blend_pixel(u32 top, u32 bottom, u8 effect, const BlendTables& tables, u32 eva, u32 evb) {
+  const bool increase = effect == EFFECT_BRIGHTEN;
+
+  switch (effect) {
+    case EFFECT_ALPHA: return tables.rgb[alpha_blend(top, bottom, eva, evb)];
+    case EFFECT_BRIGHTEN:
+    case EFFECT_DARKEN: {
+      if (top & DIRECT_COLOR) return tables.rgb[adjust_brightness(static_cast<u16>(top & 0x7FFF), tables.evy, increase)];
+      return (increase ? tables.brighter : tables.darker)[top >> PALETTE_ENTRY_SHIFT];
+    }
+    default: return tables.rgb[top & 0x7FFF];
+  }
+}
+
+static void blend_scalar(const CompositeLine& line, const u8* effect, const BlendTables& tables, u32 eva, u32 evb, u32* out) {
+  for (u32 x = 0; x < LINE_WIDTH; x++) out[x] = blend_pixel(line.top_color[x], line.bottom_color[x], effect[x], tables, eva, evb);
+}
+
+#if BASS_COMPOSITOR_X64
+// Same insertion as the scalar loop, done on 4 (SSE4.1) or 8 (AVX2) pixels with compare + blend instead of branches.
+// Keys live in 32 bit lanes next to the colours, so one mask selects both.
+
+static u32 load_u32(const u8* src) {
+  u32 v;
+  std::memcpy(&v, src, sizeof(v));
+  return v;
+}
+
+__attribute__((target("sse4.1"))) static void store_layers_sse41(u8* dst, __m128i key) {
+  __m128i layer = _mm_and_si128(key, _mm_set1_epi32(7));
+  layer         = _mm_packus_epi16(_mm_packus_epi32(layer, layer), layer);
+
+  const u32 v = static_cast<u32>(_mm_cvtsi128_si32(layer));
+  std::memcpy(dst, &v, sizeof(v));
+}
+
+__attribute__((target("sse4.1"))) static void composite_sse41(const LayerLines& layers, const u8* ids, u32 count, u32 backdrop, CompositeLine& out) {
+  const __m128i no_key = _mm_set1_epi32(NO_KEY);
+
+  for (u32 x = 0; x < LINE_WIDTH; x += 4) {
+    __m128i top_key      = _mm_set1_epi32(BACKDROP_KEY);
+    __m128i bottom_key   = no_key;
+    __m128i top_color    = _mm_set1_epi32(static_cast<i32>(backdrop));
+    __m128i bottom_color = top_color;
+
+    for (u32 i = 0; i < count; i++) {
+      const LayerLine& layer = layers[ids[i]];
+
+      const __m128i prio   = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<i32>(load_u32(&layer.prio[x]))));
+      const __m128i opaque = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(static_cast<i32>(load_u32(&layer.opaque[x]))));
+      const __m128i color  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&layer.color[x]));
+      const __m128i key    = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(prio, 3), _mm_set1_epi32(ids[i])), _mm_andnot_si128(opaque, no_key));
+
+      const __m128i above_top    = _mm_cmplt_epi32(key, top_key);
+      const __m128i above_bottom = _mm_cmplt_epi32(key, bottom_key);
+
+      bottom_key   = _mm_blendv_epi8(_mm_blendv_epi8(bottom_key, key, above_bottom), top_key, above_top);
+      bottom_color = _mm_blendv_epi8(_mm_blendv_epi8(bottom_color, color, above_bottom), top_color, above_top);
+      top_key      = _mm_blendv_epi8(top_key, key, above_top);
+      top_color    = _mm_blendv_epi8(top_color, color, above_top);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.top_color[x]), top_color);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&out.bottom_color[x]), bottom_color);
+    store_layers_sse41(&out.top_layer[x], top_key);
+    store_layers_sse41(&out.bottom_layer[x], bottom_key);
+  }
+}
+
+__attribute__((target("avx2"))) static void store_layers_avx2(u8* dst, __m256i key) {
+  const __m256i layer = _mm256_and_si256(key, _mm256_set1_epi32(7));
+  const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(layer), _mm256_extracti128_si256(layer, 1));
+
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(words, words));
+}
+
+__attribute__((target("avx2"))) static void composite_avx2(const LayerLines& layers, const u8* ids, u32 count, u32 backdrop, CompositeLine& out) {
+  const __m256i no_key = _mm256_set1_epi32(NO_KEY);
+
+  for (u32 x = 0; x < LINE_WIDTH; x += 8) {
+    __m256i top_key      = _mm256_set1_epi32(BACKDROP_KEY);
+    __m256i bottom_key   = no_key;
+    __m256i top_color    = _mm256_set1_epi32(static_cast<i32>(backdrop));
+    __m256i bottom_color = top_color;
+
+    for (u32 i = 0; i < count; i++) {
+      const LayerLine& layer = layers[ids[i]];
+
+      const __m256i prio   = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&layer.prio[x])));
+      const __m256i opaque = _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&layer.opaque[x])));
+      const __m256i color  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&layer.color[x]));
+      const __m256i key    = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(prio, 3), _mm256_set1_epi32(ids[i])), _mm256_andnot_si256(opaque, no_key));
+
+      const __m256i above_top    = _mm256_cmpgt_epi32(top_key, key);
+      const __m256i above_bottom = _mm256_cmpgt_epi32(bottom_key, key);
+
+      bottom_key   = _mm256_blendv_epi8(_mm256_blendv_epi8(bottom_key, key, above_bottom), top_key, above_top);
+      bottom_color = _mm256_blendv_epi8(_mm256_blendv_epi8(bottom_color, color, above_bottom), top_color, above_top);
+      top_key      = _mm256_blendv_epi8(top_key, key, above_top);
+      top_color    = _mm256_blendv_epi8(top_color, color, above_top);
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.top_color[x]), top_color);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out.bottom_color[x]), bottom_color);
+    store_layers_avx2(&out.top_layer[x], top_key);
+    store_layers_avx2(&out.bottom_layer[x], bottom_key);
+  }
+}
+
+// one channel of the alpha blend, in place: (t * eva + b * evb) >> 4 leaves stray bits below the channel, they
+// don't change the clamp and the mask drops them
+__attribute__((target("avx2"))) static __m256i alpha_channel_avx2(__m256i top, __m256i bottom, __m256i eva, __m256i evb, u32 channel) {
+  const __m256i mask = _mm256_set1_epi32(static_cast<i32>(channel));
+  const __m256i sum  = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(top, mask), eva), _mm256_mullo_epi32(_mm256_and_si256(bottom, mask), evb));
+
+  return _mm256_and_si256(_mm256_min_epu32(_mm256_srli_epi32(sum, 4), mask), mask);
+}
+
+// Alpha is done on the 5 bit channels of 8 pixels at once, then every pixel is one gather from the colour table,
+// and faded ones a masked gather from the palette cache. Direct colours (bitmap modes only) with a fade go the
+// scalar way.
+__attribute__((target("avx2"))) static void blend_avx2(const CompositeLine& line, const u8* effect, const BlendTables& tables, u32 eva, u32 evb, u32* out) {
+  const __m256i a      = _mm256_set1_epi32(static_cast<i32>(eva));
+  const __m256i b      = _mm256_set1_epi32(static_cast<i32>(evb));
+  const __m256i bgr    = _mm256_set1_epi32(0x7FFF);
+  const __m256i direct = _mm256_set1_epi32(DIRECT_COLOR);
+
+  const auto* rgb      = reinterpret_cast<const int*>(tables.rgb);
+  const auto* brighter = reinterpret_cast<const int*>(tables.brighter);
+  const auto* darker   = reinterpret_cast<const int*>(tables.darker);
+
+  for (u32 x = 0; x < LINE_WIDTH; x += 8) {
+    const __m256i top    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&line.top_color[x]));
+    const __m256i bottom = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&line.bottom_color[x]));
+    const __m256i e      = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&effect[x])));
+
+    const __m256i alpha   = _mm256_cmpeq_epi32(e, _mm256_set1_epi32(EFFECT_ALPHA));
+    const __m256i brighten = _mm256_cmpeq_epi32(e, _mm256_set1_epi32(EFFECT_BRIGHTEN));
+    const __m256i darken  = _mm256_cmpeq_epi32(e, _mm256_set1_epi32(EFFECT_DARKEN));
+    const __m256i fade    = _mm256_or_si256(brighten, darken);
+
+    if (!_mm256_testz_si256(fade, _mm256_cmpeq_epi32(_mm256_and_si256(top, direct), direct))) {
+      for (u32 i = x; i < x + 8; i++) out[i] = blend_pixel(line.top_color[i], line.bottom_color[i], effect[i], tables, eva, evb);
+      continue;
+    }
+
+    const __m256i blended = _mm256_or_si256(_mm256_or_si256(alpha_channel_avx2(top, bottom, a, b, 0x1F), alpha_channel_avx2(top, bottom, a, b, 0x3E0)),
+                                            alpha_channel_avx2(top, bottom, a, b, 0x7C00));
+
+    const __m256i entry = _mm256_srli_epi32(top, PALETTE_ENTRY_SHIFT);
+    __m256i color       = _mm256_i32gather_epi32(rgb, _mm256_blendv_epi8(_mm256_and_si256(top, bgr), blended, alpha), 4);
+
+    if (!_mm256_testz_si256(brighten, brighten)) color = _mm256_mask_i32gather_epi32(color, brighter, entry, brighten, 4);
+    if (!_mm256_testz_si256(darken, darken)) color = _mm256_mask_i32gather_epi32(color, darker, entry, darken, 4);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&out[x]), color);
+  }
+}
+#endif
+
+bool compositor_supported(COMPOSITOR c) {
+#if BASS_COMPOSITOR_X64
+  __builtin_cpu_init();
+
+  switch (c) {
+    case COMPOSITOR::SCALAR: return true;
+    case COMPOSITOR::SSE41: return __builtin_cpu_supports("sse4.1");
+    case COMPOSITOR::AVX2: return __builtin_cpu_supports("avx2");
+  }
+  return false;
+#else
+  return c == COMPOSITOR::SCALAR;
+#endif
+}
+
+COMPOSITOR best_compositor() {
+  if (compositor_supported(COMPOSITOR::AVX2)) return COMPOSITOR::AVX2;
+  if (compositor_supported(COMPOSITOR::SSE41)) return COMPOSITOR::SSE41;
+  return COMPOSITOR::SCALAR;
+}
+
+CompositeKernel get_composite_kernel(COMPOSITOR c) {
+#if BASS_COMPOSITOR_X64
+  switch (c) {
+    case COMPOSITOR::SCALAR: return composite_scalar;
+    case COMPOSITOR::SSE41: return composite_sse41;
+    case COMPOSITOR::AVX2: return composite_avx2;
+  }
+#else
+  (void)c;
+#endif
+  return composite_scalar;
+}
+
+BlendKernel get_blend_kernel(COMPOSITOR c) {
+#if BASS_COMPOSITOR_X64
+  switch (c) {
+    case COMPOSITOR::SCALAR: return blend_scalar;
+    case COMPOSITOR::SSE41: return blend_scalar;  // every pixel ends in a table lookup, without gathers SIMD has nothing to win
+    case COMPOSITOR::AVX2: return blend_avx2;
+  }
+#else
+  (void)c;
+#endif
+  return blend_scalar;
+}
+
+const char* compositor_name(COMPOSITOR c) {
+  switch (c) {
+    case COMPOSITOR::SCALAR: return "scalar";
+    case COMPOSITOR::SSE41: return "sse4.1";
+    case COMPOSITOR::AVX2: return "avx2";
+  }
+  return "?";
+}
@@ -16,11 +16,26 @@ ARM7TDMI::ARM7TDMI() {
   cpu_logger->set_level(spdlog::level::trace);
   regs.r[15] = 0x08000000;
   // regs.r[15] = 0;
+
+#ifdef SST_TEST_MODE
+  use_block_cache = false;  // opcodes are fed through bus transactions
+#endif
+
+  // lets the recompiler test a condition with a single bt
+  auto cpsr = regs.CPSR.value;
+  for (u8 cond = 0; cond < 16; cond++) {
+    for (u32 nzcv = 0; nzcv < 16; nzcv++) {
+      regs.CPSR.value = (cpsr & 0x0FFFFFFF) | (nzcv << 28);
+      if (check_condition(static_cast<Condition>(cond))) condition_masks[cond] |= static_cast<u16>(1 << nzcv);
+    }
+  }
+  regs.CPSR.value = cpsr;
 }
 void ARM7TDMI::flush_pipeline() {
   // fmt::println("R15 pre-flush: {:#010x}", regs.r[15]);
 
   flushed_pipeline = true;
+  bus->set_bios_readable(regs.r[15] <= 0x3FFF);
   if (regs.CPSR.STATE_BIT == ARM_MODE) {
     pipeline = {};
 
@@ -39,36 +54,6 @@ void ARM7TDMI::flush_pipeline() {
   return;
 }
 
-u32 ARM7TDMI::handle_shifts(bool I, bool R, u8 Rm, u8 Rs, u8 shift_type, u32 imm, u8 rotate, u8 shift_amount, bool S, bool affects_flags) {
-  u8 add_amount = 0;
-  if (I == 0) {
-    if (R) {  // I = 0, R = 1
-      // spdlog::info("SHIFT VALUE IS REGISTER! Operand r{} (Rm) - r{} (Rs) [{:#010x}]", Rm, Rs, regs.get_reg(Rs) & 0xff);
-      // instr.print_params();
-
-      if (Rm == 15) {
-        add_amount += 4;
-      }
-
-      return shift((SHIFT_MODE)shift_type,
-                   regs.get_reg(Rm) + add_amount,  // PC reads as PC+12 (PC already reads
-                                                   // +8) when used as shift register
-                   regs.get_reg(Rs) & 0xff, false, true, affects_flags);
-    } else {
-      return shift((SHIFT_MODE)shift_type, regs.get_reg(Rm), shift_amount, true, false, affects_flags);
-    }
-  }
-
-  if (S) {
-    // cpu_logger->info("immediate value rotate before: {}", instr.imm);
-    return shift(ROR, imm, rotate * 2, false, true);
-  } else {
-    // cpu_logger->info("rot val: {:#x}", std::rotr(imm, rotate * 2));
-    // if((instr.rotate * 2) == 0) return instr.imm;
-    return std::rotr(imm, rotate * 2);
-  }
-}
-
 u32 ARM7TDMI::fetch(u32 address) {
   u32 opcode = regs.CPSR.STATE_BIT == THUMB_MODE ? bus->read16(address) : bus->read32(address);
 
@@ -82,10 +67,12 @@ inline void ARM7TDMI::handle_interrupts() {
   if (!regs.CPSR.irq_disable && interrupt_queued() && bus->interrupt_control.IME.enabled) {
     // fmt::println("IRQ fired!");
 
+    regs.sync_flags();
+
     auto cpsr         = regs.CPSR.value;
     CPU_MODE cpu_mode = regs.CPSR.STATE_BIT;
 
-    regs.CPSR.MODE_BIT    = IRQ;
+    regs.switch_mode(IRQ);
     regs.CPSR.STATE_BIT   = ARM_MODE;
     regs.CPSR.irq_disable = true;
 
@@ -99,14 +86,10 @@ inline void ARM7TDMI::handle_interrupts() {
   };
 }
 
-u32 ARM7TDMI::step() {
-  u8 tmp = 0;
+u64 ARM7TDMI::step() {
+  u64 tmp = 0;
 
-  if (regs.r[15] != align_by_current_mode(regs.r[15])) {
-    fmt::println("something left PC unaligned -- addr: {:#010x}", regs.r[15]);
-    exit(-1);
-    assert(0);
-  }
+  assert(regs.r[15] == align_by_current_mode(regs.r[15]) && "something left PC unaligned");
 
   pipeline.execute = pipeline.decode;
   pipeline.decode  = pipeline.fetch;
@@ -118,11 +101,125 @@ u32 ARM7TDMI::step() {
   execute(pipeline.execute);
 
   regs.r[15] += regs.CPSR.STATE_BIT == THUMB_MODE ? 2 : 4;
+  instructions_executed++;
 
   tmp              = cycles_this_step;
   cycles_this_step = 0;
   return tmp;
 }
+
+// step(), with the instruction run through its translation when the recompiler has one. Only the single
+// step tests go through here, to check the recompiler against the same data the handlers get checked against.
+u64 ARM7TDMI::step_native() {
+  pipeline.execute = pipeline.decode;
+  pipeline.decode  = pipeline.fetch;
+
+  handle_interrupts();
+
+  pipeline.fetch = fetch(regs.r[15]);
+
+  NativeInstr native = jit.available() ? jit_compile_instr(pipeline.execute) : nullptr;
+  if (native != nullptr) {
+    regs.sync_flags();
+    native(this);
+  } else {
+    execute(pipeline.execute);
+  }
+
+  regs.r[15] += regs.CPSR.STATE_BIT == THUMB_MODE ? 2 : 4;
+  instructions_executed++;
+
+  u64 tmp          = cycles_this_step;
+  cycles_this_step = 0;
+  return tmp;
+}
+
+// step() back to back for as long as the cpu stays in `state`, so the fetch width, the table, the condition
+// check and the r15 increment are all fixed. Returns once BX or an exception changes state, or whenever
+// run_until() would stop.
+template <CPU_MODE state>
+void ARM7TDMI::run_interpreter(u64 target_cycle) {
+  constexpr u32 size = state == THUMB_MODE ? 2 : 4;
+
+  while (cycles_elapsed < target_cycle) {
+    pipeline.execute = pipeline.decode;
+    pipeline.decode  = pipeline.fetch;
+
+    if (irq_ready()) {  // ends up in ARM, the rest of the instruction goes the way step() does it
+      handle_interrupts();
+      pipeline.fetch = fetch(regs.r[15]);
+      execute(pipeline.execute);
+      regs.r[15] += regs.CPSR.STATE_BIT == THUMB_MODE ? 2 : 4;
+      instructions_executed++;
+      return;
+    }
+
+    const u32 opcode = pipeline.execute;
+
+    pipeline.fetch = state == THUMB_MODE ? bus->read16(regs.r[15]) : bus->read32(regs.r[15]);
+    if (regs.r[15] <= 0x3FFF) bus->bios_open_bus = pipeline.fetch;
+
+    flushed_pipeline = false;
+
+    if constexpr (state == THUMB_MODE) {
+      const FuncPtr handler = thumb_funcs[opcode >> 6];
+
+      if (handler != nullptr) {
+        handler(this, opcode);
+      } else {
+        spdlog::warn("could not resolve, opcode: {:#08X} - s: {:#08X}", opcode, opcode >> 6);
+      }
+    } else {
+      const FuncPtr handler = arm_funcs[((opcode & 0xff00000) >> 16) | ((opcode & 0b11110000) >> 4)];
+      const u8 cond         = static_cast<u8>(opcode >> 28);
+
+      if (cond != AL) regs.sync_flags();
+
+      if (handler == nullptr) {
+        spdlog::warn("could not resolve, opcode: {:#08X}", opcode);
+      } else if (cond == AL || (condition_masks[cond] >> (regs.CPSR.value >> 28)) & 1) {
+        handler(this, opcode);
+      }
+    }
+
+    instructions_executed++;
+
+    if (regs.CPSR.STATE_BIT != state) {
+      regs.r[15] += state == THUMB_MODE ? 4 : 2;  // the new state's size, BX flushed already
+      return;
+    }
+
+    regs.r[15] += size;
+
+    if (bus->dma_requested || bus->scheduler->preempted || halted) return;
+    if (flushed_pipeline && hle_check.pending) hle_check_result();
+  }
+}
+
+void ARM7TDMI::run_until(u64 target_cycle) {
+  while (cycles_elapsed < target_cycle) {
+    if (!use_block_cache) {
+      if (regs.CPSR.STATE_BIT == THUMB_MODE) {
+        run_interpreter<THUMB_MODE>(target_cycle);
+      } else {
+        run_interpreter<ARM_MODE>(target_cycle);
+      }
+
+      if (bus->dma_requested || bus->scheduler->preempted || halted) break;
+      continue;
+    }
+
+    Block* block = get_block();
+
+    if (block == nullptr || (run_native(*block, target_cycle) == 0 && run_block(*block, target_cycle) == 0)) step();
+
+    if (bus->dma_requested || bus->scheduler->preempted || halted) break;
+    if (block != nullptr && block->idle_loop && use_idle_skip) check_idle_loop(*block, target_cycle);
+    if (hle_check.pending) hle_check_result();
+  }
+
+  regs.sync_flags();  // leave CPSR readable for whatever runs between batches
+}
 void ARM7TDMI::print_pipeline() const {
   fmt::println("============ PIPELINE ============");
   fmt::println("Fetch:  {:#010X}", this->pipeline.fetch);
@@ -147,7 +244,7 @@ void ARM7TDMI::execute(u32 opcode) {
   }
 
   if (func == nullptr) spdlog::warn("could not resolve, opcode: {:#08X} - s: {:#08X}", opcode, shifted_opcode);
-  if (!check_condition(static_cast<Condition>(opcode >> 28)) && regs.CPSR.STATE_BIT == ARM_MODE) return;
+  if (regs.CPSR.STATE_BIT == ARM_MODE && !check_condition(static_cast<Condition>(opcode >> 28))) return;
 
   if (func == nullptr) {
     fmt::println("could not execute instruction {:#010X}", opcode);
@@ -158,7 +255,11 @@ void ARM7TDMI::execute(u32 opcode) {
   func(this, opcode);
 }
 
-bool ARM7TDMI::check_condition(Condition cond) const {
+bool ARM7TDMI::check_condition(Condition cond) {
+  if (cond == AL) return true;
+
+  regs.sync_flags();
+
   switch (cond) {
     case EQ: {
       return regs.CPSR.ZERO_FLAG;
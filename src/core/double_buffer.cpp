@@ -1,10 +1,15 @@
 #include "double_buffer.hpp"
 
 #include <cassert>
+#include <cstring>
 #include <utility>
 
 void DoubleBuffer::write(const size_t idx, const u32 value) {
   assert(idx < 241 * 160);
   write_buf[idx] = value;
 }
+void DoubleBuffer::write_line(const size_t idx, const u32* values, const size_t count) {
+  assert(idx + count <= 241 * 160);
+  std::memcpy(&write_buf[idx], values, count * sizeof(u32));
+}
 void DoubleBuffer::swap_buffers() { std::swap(write_buf, disp_buf); };
\ No newline at end of file
@@ -95,8 +95,10 @@ void THUMB_ADD_CMP_MOV_HI(ARM7TDMI* cpu, u32 opcode) {
     default: assert(0);
   }
 };
-void THUMB_MOV_CMP_ADD_SUB(ARM7TDMI* cpu, u32 opcode) {
-  u8 op        = (opcode >> 11) & 0b11;
+void THUMB_MOV_CMP_ADD_SUB(ARM7TDMI* cpu, u32 opcode) { ARM7TDMI::thumb_funcs[(opcode >> 6) & 0x3FF](cpu, opcode); }
+
+template <u8 op>
+void THUMB_MOV_CMP_ADD_SUB_T(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd        = (opcode >> 8) & 0b111;
   u32 Rd_value = cpu->regs.get_reg(Rd);
   u8 nn        = opcode & 0xFF;
@@ -106,8 +108,7 @@ void THUMB_MOV_CMP_ADD_SUB(ARM7TDMI* cpu, u32 opcode) {
       // fmt::println("MOV");
       cpu->regs.get_reg(Rd) = nn;
 
-      is_negative(nn) ? cpu->set_negative() : cpu->reset_negative();
-      nn == 0 ? cpu->set_zero() : cpu->reset_zero();
+      cpu->regs.set_logical_flags(nn);
 
       break;
     }
@@ -115,32 +116,18 @@ void THUMB_MOV_CMP_ADD_SUB(ARM7TDMI* cpu, u32 opcode) {
       // fmt::println("CMP");
       u32 result = Rd_value - nn;
 
-      u32 rn_msb  = Rd_value & 0x80000000;
-      u32 rm_msb  = nn & 0x80000000;
-      u32 res_msb = result & 0x80000000;
-
-      result == 0 ? cpu->set_zero() : cpu->reset_zero();
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-      (rn_msb != rm_msb && rn_msb != res_msb) ? cpu->set_overflow() : cpu->reset_overflow();
-      Rd_value >= nn ? cpu->set_carry() : cpu->reset_carry();
+      cpu->regs.set_sub_flags(Rd_value, nn, result);
 
       break;
     }
     case 2: {
       // fmt::println("ADD");
 
-      u64 result_64 = (u64)Rd_value + nn;
       u32 result_32 = Rd_value + nn;
 
       cpu->regs.get_reg(Rd) = result_32;
 
-      result_32 == 0 ? cpu->set_zero() : cpu->reset_zero();
-
-      u32 overflow = ~(Rd_value ^ nn) & (Rd_value ^ result_64);
-      ((overflow >> 31) & 1) ? cpu->set_overflow() : cpu->reset_overflow();
-
-      (result_64 > U32_MAX) ? cpu->set_carry() : cpu->reset_carry();
-      is_negative(result_32) ? cpu->set_negative() : cpu->reset_negative();
+      cpu->regs.set_add_flags(Rd_value, nn, result_32);
 
       break;
     }
@@ -150,14 +137,7 @@ void THUMB_MOV_CMP_ADD_SUB(ARM7TDMI* cpu, u32 opcode) {
 
       cpu->regs.get_reg(Rd) = result;
 
-      u32 rn_msb  = Rd_value & 0x80000000;
-      u32 rm_msb  = nn & 0x80000000;
-      u32 res_msb = result & 0x80000000;
-
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-      result == 0 ? cpu->set_zero() : cpu->reset_zero();
-      Rd_value >= nn ? cpu->set_carry() : cpu->reset_carry();
-      (rn_msb != rm_msb && rn_msb != res_msb) ? cpu->set_overflow() : cpu->reset_overflow();
+      cpu->regs.set_sub_flags(Rd_value, nn, result);
 
       break;
     }
@@ -420,6 +400,7 @@ void ARM_PSR_TRANSFER(ARM7TDMI* cpu, u32 x) {
     case MRS: {
       u8 Rd = (x >> 12) & 0xF;
       if (P == CPSR) {
+        cpu->regs.sync_flags();
         psr = cpu->regs.CPSR.value;
       } else {
         psr = cpu->regs.get_spsr(cpu->regs.CPSR.MODE_BIT);
@@ -748,12 +729,17 @@ void ARM_SWAP(ARM7TDMI* cpu, u32 x) {
 }
 
 void ARM_SOFTWARE_INTERRUPT(ARM7TDMI* cpu, u32 x) {
-  (void)x;
+  if (cpu->use_hle_bios) {
+    const u8 number = cpu->regs.CPSR.STATE_BIT == THUMB_MODE ? x & 0xFF : (x >> 16) & 0xFF;
+    if (cpu->hle_swi(number)) return;  // back at the next instruction, like the BIOS returning
+  }
+
+  cpu->regs.sync_flags();
 
   auto cpsr = cpu->regs.CPSR.value;
 
-  cpu->regs.CPSR.MODE_BIT    = SUPERVISOR;
-  cpu->regs.svc_r[14]        = cpu->regs.r[15] - (cpu->regs.CPSR.STATE_BIT == THUMB_MODE ? 2 : 4);
+  cpu->regs.switch_mode(SUPERVISOR);
+  cpu->regs.r[14]            = cpu->regs.r[15] - (cpu->regs.CPSR.STATE_BIT == THUMB_MODE ? 2 : 4);
   cpu->regs.SPSR_svc         = cpsr;
   cpu->regs.CPSR.STATE_BIT   = ARM_MODE;
   cpu->regs.CPSR.irq_disable = true;
@@ -763,29 +749,27 @@ void ARM_SOFTWARE_INTERRUPT(ARM7TDMI* cpu, u32 x) {
   cpu->flush_pipeline();
 }
 
-void ARM_DATA_PROCESSING(ARM7TDMI* cpu, u32 x) {
-  (void)(cpu);
-  (void)(x);
+void ARM_DATA_PROCESSING(ARM7TDMI* cpu, u32 x) { ARM7TDMI::arm_funcs[((x & 0xff00000) >> 16) | ((x & 0xF0) >> 4)](cpu, x); }
 
-  ALU_OP data_proc_op = static_cast<ALU_OP>((x >> 21) & 0xF);
-
-  switch (data_proc_op) {
-    case ALU_OP::AND: AND(cpu, x); break;
-    case ALU_OP::EOR: EOR(cpu, x); break;
-    case ALU_OP::SUB: SUB(cpu, x); break;
-    case ALU_OP::RSB: RSB(cpu, x); break;
-    case ALU_OP::ADD: ADD(cpu, x); break;
-    case ALU_OP::ADC: ADC(cpu, x); break;
-    case ALU_OP::SBC: SBC(cpu, x); break;
-    case ALU_OP::RSC: RSC(cpu, x); break;
-    case ALU_OP::TST: TST(cpu, x); break;
-    case ALU_OP::TEQ: TEQ(cpu, x); break;
-    case ALU_OP::CMP: CMP(cpu, x); break;
-    case ALU_OP::CMN: CMN(cpu, x); break;
-    case ALU_OP::ORR: ORR(cpu, x); break;
-    case ALU_OP::MOV: MOV(cpu, x); break;
-    case ALU_OP::BIC: BIC(cpu, x); break;
-    case ALU_OP::MVN: MVN(cpu, x); break;
+template <ALU_OP op, bool I, bool S, bool R, u8 shift_type>
+void ARM_DATA_PROCESSING_T(ARM7TDMI* cpu, u32 x) {
+  switch (op) {
+    case ALU_OP::AND: AND<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::EOR: EOR<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::SUB: SUB<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::RSB: RSB<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::ADD: ADD<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::ADC: ADC<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::SBC: SBC<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::RSC: RSC<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::TST: TST<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::TEQ: TEQ<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::CMP: CMP<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::CMN: CMN<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::ORR: ORR<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::MOV: MOV<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::BIC: BIC<I, S, R, shift_type>(cpu, x); break;
+    case ALU_OP::MVN: MVN<I, S, R, shift_type>(cpu, x); break;
   }
 }
 void ARM_SIGNED_LOAD(ARM7TDMI* cpu, u32 x) {
@@ -889,19 +873,20 @@ void THUMB_UNCONDITIONAL_BRANCH(ARM7TDMI* cpu, u32 opcode) {
   cpu->regs.r[15] += x;
   cpu->flush_pipeline();
 }
-void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) {
-  THUMB_ALU_OP op = static_cast<THUMB_ALU_OP>((opcode >> 6) & 0xF);
-  u8 Rd           = opcode & 0b111;
-  u8 Rs           = (opcode >> 3) & 0b111;
-  u32 Rd_value    = cpu->regs.get_reg(Rd);
-  u32 Rs_value    = cpu->regs.get_reg(Rs);
+void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) { ARM7TDMI::thumb_funcs[(opcode >> 6) & 0x3FF](cpu, opcode); }
+
+template <THUMB_ALU_OP op>
+void THUMB_DATA_PROC_T(ARM7TDMI* cpu, u32 opcode) {
+  u8 Rd        = opcode & 0b111;
+  u8 Rs        = (opcode >> 3) & 0b111;
+  u32 Rd_value = cpu->regs.get_reg(Rd);
+  u32 Rs_value = cpu->regs.get_reg(Rs);
   // fmt::println("{:#08X} dd", (opcode >> 6) & 0xF);
   switch (op) {  // handle op
     case THUMB_ALU_OP::AND: {
       u32 result = Rd_value & Rs_value;
 
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-      is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
+      cpu->regs.set_logical_flags(result);
 
       cpu->regs.get_reg(Rd) = result;
       break;
@@ -909,8 +894,7 @@ void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) {
     case THUMB_ALU_OP::EOR: {
       u32 result = Rd_value ^ Rs_value;
 
-      is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
+      cpu->regs.set_logical_flags(result);
 
       cpu->regs.get_reg(Rd) = result;
       break;
@@ -918,8 +902,7 @@ void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) {
     case THUMB_ALU_OP::LSL: {
       u32 result = cpu->shift(ARM7TDMI::LSL, Rd_value, (Rs_value & 0xFF), false);
       // fmt::println("amount: {}", (Rs_value & 0xFF));
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-      is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
+      cpu->regs.set_logical_flags(result);
 
       cpu->regs.get_reg(Rd) = result;
       break;
@@ -927,21 +910,19 @@ void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) {
     case THUMB_ALU_OP::LSR: {
       u32 result = cpu->shift(ARM7TDMI::LSR, Rd_value, (Rs_value & 0xFF), false);
 
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-      is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
+      cpu->regs.set_logical_flags(result);
 
       cpu->regs.get_reg(Rd) = result;
       break;
     }
     case THUMB_ALU_OP::ASR: {
       u32 result = cpu->shift(ARM7TDMI::ASR, Rd_value, (Rs_value & 0xFF), false);
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-      is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
+      cpu->regs.set_logical_flags(result);
       cpu->regs.get_reg(Rd) = result;
       break;
     }
     case THUMB_ALU_OP::ADC: {
-      bool old_carry = cpu->regs.CPSR.CARRY_FLAG;
+      bool old_carry = cpu->get_carry();
 
       u64 result_64 = ((u64)Rd_value + Rs_value + old_carry);
       u32 result_32 = (Rd_value + Rs_value + old_carry);
@@ -958,7 +939,7 @@ void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) {
       break;
     }
     case THUMB_ALU_OP::SBC: {
-      bool old_carry = cpu->regs.CPSR.CARRY_FLAG;
+      bool old_carry = cpu->get_carry();
 
       u32 result = Rd_value - Rs_value + (old_carry - 1);
 
@@ -978,8 +959,7 @@ void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) {
     case THUMB_ALU_OP::ROR: {
       u32 result = cpu->shift(ARM7TDMI::ROR, Rd_value, (Rs_value & 0xFF), false);
 
-      is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
+      cpu->regs.set_logical_flags(result);
 
       cpu->regs.get_reg(Rd) = result;
       break;
@@ -987,8 +967,7 @@ void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) {
     case THUMB_ALU_OP::TST: {
       u32 d = Rd_value & Rs_value;
 
-      is_zero(d) ? cpu->set_zero() : cpu->reset_zero();
-      is_negative(d) ? cpu->set_negative() : cpu->reset_negative();
+      cpu->regs.set_logical_flags(d);
       break;
     }
     case THUMB_ALU_OP::NEG: {
@@ -1008,44 +987,21 @@ void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) {
     case THUMB_ALU_OP::CMP: {
       u32 result = Rd_value - Rs_value;
 
-      u32 rn_msb  = Rd_value & 0x80000000;
-      u32 rm_msb  = Rs_value & 0x80000000;
-      u32 res_msb = result & 0x80000000;
-
-      is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-      (rn_msb != rm_msb && rn_msb != res_msb) ? cpu->set_overflow() : cpu->reset_overflow();
-      (Rd_value >= Rs_value) ? cpu->set_carry() : cpu->reset_carry();
+      cpu->regs.set_sub_flags(Rd_value, Rs_value, result);
 
       break;
     }
     case THUMB_ALU_OP::CMN: {
-      u64 r_64 = (u64)Rd_value + Rs_value;
-      u32 r    = Rd_value + Rs_value;
-
-      u32 rn_msb  = Rd_value & 0x80000000;
-      u32 rm_msb  = Rs_value & 0x80000000;
-      u32 res_msb = r & 0x80000000;
+      u32 r = Rd_value + Rs_value;
 
-      is_negative(r) ? cpu->set_negative() : cpu->reset_negative();
-      is_zero(r) ? cpu->set_zero() : cpu->reset_zero();
-      (r_64 > U32_MAX) ? cpu->set_carry() : cpu->reset_carry();
-
-      if (rn_msb != 0 && rm_msb != 0 && res_msb == 0) {
-        cpu->set_overflow();
-      } else if (rn_msb == 0 && rm_msb == 0 && res_msb != 0) {
-        cpu->set_overflow();
-      } else {
-        cpu->reset_overflow();
-      }
+      cpu->regs.set_add_flags(Rd_value, Rs_value, r);
 
       break;
     }
     case THUMB_ALU_OP::ORR: {
       u32 result = Rd_value | Rs_value;
 
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-      is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
+      cpu->regs.set_logical_flags(result);
 
       cpu->regs.get_reg(Rd) = result;
       break;
@@ -1063,8 +1019,7 @@ void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) {
     case THUMB_ALU_OP::BIC: {
       u32 result = Rd_value & ~Rs_value;
 
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-      is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
+      cpu->regs.set_logical_flags(result);
 
       cpu->regs.get_reg(Rd) = result;
       break;
@@ -1073,16 +1028,17 @@ void THUMB_DATA_PROC(ARM7TDMI* cpu, u32 opcode) {
       // fmt::println("MVN: {:#08X} - {:#08X}", (u32)Rs_value, (u32)~Rs_value);
       u32 result            = ~Rs_value;
       cpu->regs.get_reg(Rd) = result;
-      is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-      is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
+      cpu->regs.set_logical_flags(result);
 
       break;
     }
   }
 }
 
-void THUMB_MOVE_SHIFTED_REG(ARM7TDMI* cpu, u32 opcode) {
-  u8 op     = (opcode >> 11) & 0b11;
+void THUMB_MOVE_SHIFTED_REG(ARM7TDMI* cpu, u32 opcode) { ARM7TDMI::thumb_funcs[(opcode >> 6) & 0x3FF](cpu, opcode); }
+
+template <u8 op>
+void THUMB_MOVE_SHIFTED_REG_T(ARM7TDMI* cpu, u32 opcode) {
   u8 Rs     = (opcode >> 3) & 0b111;
   u8 Rd     = (opcode) & 0b111;
   u8 offset = (opcode >> 6) & 0b11111;
@@ -1110,8 +1066,7 @@ void THUMB_MOVE_SHIFTED_REG(ARM7TDMI* cpu, u32 opcode) {
     }
   }
 
-  is_zero(source_value) ? cpu->set_zero() : cpu->reset_zero();
-  is_negative(source_value) ? cpu->set_negative() : cpu->reset_negative();
+  cpu->regs.set_logical_flags(source_value);
   if (Rd == 15) {
     cpu->regs.load_spsr_to_cpsr();
   }
@@ -1124,8 +1079,10 @@ void THUMB_MOVE_SHIFTED_REG(ARM7TDMI* cpu, u32 opcode) {
   }
 }
 
-void THUMB_ADD_SUB(ARM7TDMI* cpu, u32 opcode) {  // THUMB.2
-  u8 op        = ((opcode >> 9) & 0b11);
+void THUMB_ADD_SUB(ARM7TDMI* cpu, u32 opcode) { ARM7TDMI::thumb_funcs[(opcode >> 6) & 0x3FF](cpu, opcode); }
+
+template <u8 op>
+void THUMB_ADD_SUB_T(ARM7TDMI* cpu, u32 opcode) {  // THUMB.2
   u32 Rs_value = cpu->regs.get_reg((opcode >> 3) & 0b111);
   u32 Rn_value = cpu->regs.get_reg((opcode >> 6) & 0b111);
   u8 reg_imm   = (opcode >> 6) & 0b111;  // both used as register operand, and immediate (Rn && nn)
@@ -1133,65 +1090,35 @@ void THUMB_ADD_SUB(ARM7TDMI* cpu, u32 opcode) {  // THUMB.2
   // fmt::println("add sub: {}", op);
   switch (op) {
     case 0: {
-      u64 result_64 = (u64)Rs_value + Rn_value;
       u32 result_32 = Rs_value + Rn_value;
 
       cpu->regs.get_reg(Rd) = result_32;
 
-      result_32 == 0 ? cpu->set_zero() : cpu->reset_zero();
-
-      u32 overflow = ~(Rs_value ^ Rn_value) & (Rs_value ^ result_64);
-      ((overflow >> 31) & 1) ? cpu->set_overflow() : cpu->reset_overflow();
-
-      (result_64 > U32_MAX) ? cpu->set_carry() : cpu->reset_carry();
-      is_negative(result_32) ? cpu->set_negative() : cpu->reset_negative();
+      cpu->regs.set_add_flags(Rs_value, Rn_value, result_32);
 
       break;
     }
     case 1: {
       u32 result = Rs_value - Rn_value;
 
-      u32 rn_msb  = Rs_value & 0x80000000;
-      u32 rm_msb  = Rn_value & 0x80000000;
-      u32 res_msb = result & 0x80000000;
-
-      is_negative((Rs_value - Rn_value)) ? cpu->set_negative() : cpu->reset_negative();
-      is_zero((Rs_value - Rn_value)) ? cpu->set_zero() : cpu->reset_zero();
-
-      Rs_value >= Rn_value ? cpu->set_carry() : cpu->reset_carry();
-      (rn_msb != rm_msb && rn_msb != res_msb) ? cpu->set_overflow() : cpu->reset_overflow();
+      cpu->regs.set_sub_flags(Rs_value, Rn_value, result);
 
       cpu->regs.get_reg(Rd) = result;
       break;
     }
     case 2: {
-      u64 result_64 = (u64)Rs_value + reg_imm;
       u32 result_32 = Rs_value + reg_imm;
 
       cpu->regs.get_reg(Rd) = result_32;
 
-      result_32 == 0 ? cpu->set_zero() : cpu->reset_zero();
-
-      u32 overflow = ~(Rs_value ^ reg_imm) & (Rs_value ^ result_64);
-      ((overflow >> 31) & 1) ? cpu->set_overflow() : cpu->reset_overflow();
-
-      (result_64 > U32_MAX) ? cpu->set_carry() : cpu->reset_carry();
-      is_negative(result_32) ? cpu->set_negative() : cpu->reset_negative();
+      cpu->regs.set_add_flags(Rs_value, reg_imm, result_32);
 
       break;
     }
     case 3: {
       u32 result = Rs_value - reg_imm;
 
-      u32 rn_msb  = Rs_value & 0x80000000;
-      u32 rm_msb  = reg_imm & 0x80000000;
-      u32 res_msb = result & 0x80000000;
-
-      is_negative((Rs_value - reg_imm)) ? cpu->set_negative() : cpu->reset_negative();
-      is_zero((Rs_value - reg_imm)) ? cpu->set_zero() : cpu->reset_zero();
-
-      Rs_value >= reg_imm ? cpu->set_carry() : cpu->reset_carry();
-      (rn_msb != rm_msb && rn_msb != res_msb) ? cpu->set_overflow() : cpu->reset_overflow();
+      cpu->regs.set_sub_flags(Rs_value, reg_imm, result);
 
       cpu->regs.get_reg(Rd) = result;
       break;
@@ -1199,29 +1126,25 @@ void THUMB_ADD_SUB(ARM7TDMI* cpu, u32 opcode) {  // THUMB.2
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void AND(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   u32 op1 = cpu->regs.get_reg(Rn);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, S);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, S>(Rm, Rs, imm, rotate, shift_amount);
 
   check_r15_lookahead(Rn, I, R, op1);
 
   u32 result = op1 & op2;
 
-  if (S) {
-    is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-    is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
+  if constexpr (S) {
+    cpu->regs.set_logical_flags(result);
 
     if (Rd == 15) {
       cpu->regs.load_spsr_to_cpsr();
@@ -1235,29 +1158,25 @@ void AND(ARM7TDMI* cpu, u32 opcode) {
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void EOR(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   u32 op1 = cpu->regs.get_reg(Rn);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, S);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, S>(Rm, Rs, imm, rotate, shift_amount);
 
   check_r15_lookahead(Rn, I, R, op1);
 
   u32 result = op1 ^ op2;
 
-  if (S) {
-    is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
-    is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
+  if constexpr (S) {
+    cpu->regs.set_logical_flags(result);
     if (Rd == 15) {
       cpu->regs.load_spsr_to_cpsr();
     }
@@ -1269,22 +1188,19 @@ void EOR(ARM7TDMI* cpu, u32 opcode) {
     cpu->flush_pipeline();
   }
 }
+template <bool I, bool S, bool R, u8 shift_type>
 void BIC(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   u32 op1 = cpu->regs.get_reg(Rn);
   // op2 = cpu->handle_shifts(instr, instr.S);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, S);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, S>(Rm, Rs, imm, rotate, shift_amount);
 
   // check_r15_lookahead(instr, op1);
 
@@ -1292,9 +1208,8 @@ void BIC(ARM7TDMI* cpu, u32 opcode) {
 
   auto result = op1 & (~op2);
 
-  if (S) {
-    is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-    is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
+  if constexpr (S) {
+    cpu->regs.set_logical_flags(result);
     if (Rd == 15) {
       cpu->regs.load_spsr_to_cpsr();
     }
@@ -1315,22 +1230,19 @@ void check_r15_lookahead(u8 Rn, bool I, bool R, u32& op1) {
   // if (instr.I == 0 && instr.shift_value_is_register && instr.Rm == 15 && instr.op2 != U32_MAX && instr.op2 != 0) instr.op2 += 4;
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void RSB(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   u32 op1 = cpu->regs.get_reg(Rn);
   // instr.op2 = cpu->handle_shifts(instr, false);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, false);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, false>(Rm, Rs, imm, rotate, shift_amount);
 
   // check_r15_lookahead(instr, op1);
 
@@ -1342,7 +1254,7 @@ void RSB(ARM7TDMI* cpu, u32 opcode) {
   u32 rn_msb  = op1 & 0x80000000;
   u32 res_msb = result & 0x80000000;
 
-  if (S) {
+  if constexpr (S) {
     is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
     is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
     ((op2_msb ^ res_msb) & (op2_msb ^ rn_msb)) ? cpu->set_overflow() : cpu->reset_overflow();
@@ -1360,22 +1272,19 @@ void RSB(ARM7TDMI* cpu, u32 opcode) {
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void SUB(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   u32 op1 = cpu->regs.get_reg(Rn);
   // op2 = cpu->handle_shifts(instr, false);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, false);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, false>(Rm, Rs, imm, rotate, shift_amount);
 
   // check_r15_lookahead(instr, op1);
 
@@ -1383,16 +1292,8 @@ void SUB(ARM7TDMI* cpu, u32 opcode) {
 
   u32 result = op1 - op2;
 
-  u32 rn_msb  = op1 & 0x80000000;
-  u32 rm_msb  = op2 & 0x80000000;
-  u32 res_msb = result & 0x80000000;
-
-  if (S) {
-    is_negative((op1 - op2)) ? cpu->set_negative() : cpu->reset_negative();
-    is_zero((op1 - op2)) ? cpu->set_zero() : cpu->reset_zero();
-
-    op1 >= op2 ? cpu->set_carry() : cpu->reset_carry();
-    (rn_msb != rm_msb && rn_msb != res_msb) ? cpu->set_overflow() : cpu->reset_overflow();
+  if constexpr (S) {
+    cpu->regs.set_sub_flags(op1, op2, result);
 
     if (Rd == 15) {
       cpu->regs.load_spsr_to_cpsr();
@@ -1407,23 +1308,20 @@ void SUB(ARM7TDMI* cpu, u32 opcode) {
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void SBC(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode >> 16) & 0xF;
   u8 Rs           = (opcode >> 8) & 0xF;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
-  bool old_carry = cpu->regs.CPSR.CARRY_FLAG;
+  bool old_carry = cpu->get_carry();
   u32 op1        = cpu->regs.get_reg(Rn);
   // op2      = cpu->handle_shifts(instr, false);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, false);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, false>(Rm, Rs, imm, rotate, shift_amount);
 
   // check_r15_lookahead(instr, op1);
   // spdlog::info("Op1 pre-lookahead: {} [Rn = {}]", op1, Rn);
@@ -1440,7 +1338,7 @@ void SBC(ARM7TDMI* cpu, u32 opcode) {
   u32 rm_msb  = op2 & 0x80000000;
   u32 res_msb = result & 0x80000000;
 
-  if (S) {
+  if constexpr (S) {
     is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
     is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
     (op1 >= ((u64)op2 + (1 - old_carry))) ? cpu->set_carry() : cpu->reset_carry();
@@ -1459,18 +1357,15 @@ void SBC(ARM7TDMI* cpu, u32 opcode) {
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void MVN(ARM7TDMI* cpu, u32 opcode) {
   // fmt::println("is mvn");
-  u8 Rd  = (opcode >> 12) & 0xF;
-  bool I = opcode & (1 << 25);
-  bool S = (opcode & (1 << 20));
-  u8 Rm  = opcode & 0xf;
+  u8 Rd = (opcode >> 12) & 0xF;
+  u8 Rm = opcode & 0xf;
   // u8 Rn     = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode >> 8) & 0xF;
-  bool R          = (opcode >> 4) & 1;
   u32 imm         = opcode & 0xff;
   u8 rotate       = (opcode >> 8) & 0xF;
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
   // op2 = cpu->handle_shifts(instr, S);
   // fmt::println("shift type: {}", shift_type);
@@ -1482,11 +1377,10 @@ void MVN(ARM7TDMI* cpu, u32 opcode) {
   // fmt::println("Rm: {:#x}", cpu->regs.get_reg(Rm));
   // fmt::println("imm: {:#x}", imm);
 
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, S);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, S>(Rm, Rs, imm, rotate, shift_amount);
 
-  if (S) {
-    ~op2 == 0 ? cpu->set_zero() : cpu->reset_zero();
-    (~op2 & 0x80000000) != 0 ? cpu->set_negative() : cpu->reset_negative();
+  if constexpr (S) {
+    cpu->regs.set_logical_flags(~op2);
     if (Rd == 15 && S) {
       cpu->regs.load_spsr_to_cpsr();
     }
@@ -1500,25 +1394,22 @@ void MVN(ARM7TDMI* cpu, u32 opcode) {
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void ADC(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   // Carry from barrel shifter should not be used for this instruction.
-  bool old_carry = cpu->regs.CPSR.CARRY_FLAG;
+  bool old_carry = cpu->get_carry();
 
   u32 op1 = cpu->regs.get_reg(Rn);
   // op2 = cpu->handle_shifts(instr, false);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, false);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, false>(Rm, Rs, imm, rotate, shift_amount);
 
   u64 result_64 = ((u64)cpu->regs.get_reg(Rn) + op2 + old_carry);
   u32 result_32 = (cpu->regs.get_reg(Rn) + op2 + old_carry);
@@ -1526,7 +1417,7 @@ void ADC(ARM7TDMI* cpu, u32 opcode) {
   // check_r15_lookahead(instr, op1);
   check_r15_lookahead(Rn, I, R, op1);
 
-  if (S) {
+  if constexpr (S) {
     result_32 == 0 ? cpu->set_zero() : cpu->reset_zero();
 
     u32 overflow = ~(op1 ^ op2) & (op1 ^ result_32);
@@ -1548,21 +1439,18 @@ void ADC(ARM7TDMI* cpu, u32 opcode) {
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void TEQ(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   // op2 = cpu->handle_shifts(instr, S);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, S);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, S>(Rm, Rs, imm, rotate, shift_amount);
 
   u32 m = cpu->regs.get_reg(Rn) ^ op2;
 
@@ -1582,33 +1470,28 @@ void TEQ(ARM7TDMI* cpu, u32 opcode) {
     }
   }
 
-  is_negative(m) ? cpu->set_negative() : cpu->reset_negative();
-  is_zero(m) ? cpu->set_zero() : cpu->reset_zero();
+  cpu->regs.set_logical_flags(m);
 
   if (Rd == 15 && S) {
     cpu->regs.load_spsr_to_cpsr();
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void MOV(ARM7TDMI* cpu, u32 opcode) {
-  u8 Rd  = (opcode & 0xf000) >> 12;
-  bool I = opcode & (1 << 25);
-  bool S = (opcode & (1 << 20));
-  u8 Rm  = opcode & 0xf;
+  u8 Rd = (opcode & 0xf000) >> 12;
+  u8 Rm = opcode & 0xf;
   // u8 Rn     = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   // op2 = cpu->handle_shifts(instr, S);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, S);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, S>(Rm, Rs, imm, rotate, shift_amount);
 
-  if (S) {
-    is_zero(op2) ? cpu->set_zero() : cpu->reset_zero();
-    is_negative(op2) ? cpu->set_negative() : cpu->reset_negative();
+  if constexpr (S) {
+    cpu->regs.set_logical_flags(op2);
     if (Rd == 15) {
       cpu->regs.load_spsr_to_cpsr();
     }
@@ -1621,23 +1504,20 @@ void MOV(ARM7TDMI* cpu, u32 opcode) {
     cpu->flush_pipeline();
   }
 }
+template <bool I, bool S, bool R, u8 shift_type>
 void ADD(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   if (cpu->regs.CPSR.STATE_BIT == THUMB_MODE) {}
 
   u32 op1 = cpu->regs.get_reg(Rn);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, false);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, false>(Rm, Rs, imm, rotate, shift_amount);
 
   check_r15_lookahead(Rn, I, R, op1);
 
@@ -1645,17 +1525,10 @@ void ADD(ARM7TDMI* cpu, u32 opcode) {
   //   op1 &= ~2;
   // }
 
-  u64 result_64 = (u64)op1 + op2;
   u32 result_32 = op1 + op2;
 
-  if (S) {
-    result_32 == 0 ? cpu->set_zero() : cpu->reset_zero();
-
-    u32 overflow = ~(op1 ^ op2) & (op1 ^ result_64);
-    ((overflow >> 31) & 1) ? cpu->set_overflow() : cpu->reset_overflow();
-
-    (result_64 > U32_MAX) ? cpu->set_carry() : cpu->reset_carry();
-    is_negative(result_32) ? cpu->set_negative() : cpu->reset_negative();
+  if constexpr (S) {
+    cpu->regs.set_add_flags(op1, op2, result_32);
     if (Rd == 15) {
       cpu->regs.load_spsr_to_cpsr();
     }
@@ -1669,30 +1542,26 @@ void ADD(ARM7TDMI* cpu, u32 opcode) {
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void TST(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   u32 op1 = cpu->regs.get_reg(Rn);
   // op2 = cpu->handle_shifts(instr, S);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, S);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, S>(Rm, Rs, imm, rotate, shift_amount);
 
   // check_r15_lookahead(instr, op1);
   check_r15_lookahead(Rn, I, R, op1);
 
   u32 d = op1 & op2;
 
-  is_zero(d) ? cpu->set_zero() : cpu->reset_zero();
-  is_negative(d) ? cpu->set_negative() : cpu->reset_negative();
+  cpu->regs.set_logical_flags(d);
 
   if (Rd == 15 && S) {
     cpu->regs.load_spsr_to_cpsr();
@@ -1812,66 +1681,44 @@ void single_data_transfer_writeback_ldr(ARM7TDMI* cpu, u8 Rd, u8 Rn, u32 address
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void CMN(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   u32 op1 = cpu->regs.get_reg(Rn);
   // op2 = cpu->handle_shifts(instr, false);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, false);
-
-  u64 r_64 = (u64)op1 + op2;
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, false>(Rm, Rs, imm, rotate, shift_amount);
 
   u32 r = op1 + op2;
 
-  u32 rn_msb  = op1 & 0x80000000;
-  u32 rm_msb  = op2 & 0x80000000;
-  u32 res_msb = r & 0x80000000;
-
-  is_negative(r) ? cpu->set_negative() : cpu->reset_negative();
-  is_zero(r) ? cpu->set_zero() : cpu->reset_zero();
-  (r_64 > U32_MAX) ? cpu->set_carry() : cpu->reset_carry();
-
-  if (rn_msb != 0 && rm_msb != 0 && res_msb == 0) {
-    cpu->set_overflow();
-  } else if (rn_msb == 0 && rm_msb == 0 && res_msb != 0) {
-    cpu->set_overflow();
-  } else {
-    cpu->reset_overflow();
-  }
+  cpu->regs.set_add_flags(op1, op2, r);
 
   if (Rd == 15 && S) {
     cpu->regs.load_spsr_to_cpsr();
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void RSC(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
-  bool old_carry = cpu->regs.CPSR.CARRY_FLAG;
+  bool old_carry = cpu->get_carry();
   u32 op1        = cpu->regs.get_reg(Rn);
 
   // op2 = cpu->handle_shifts(instr, false);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, false);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, false>(Rm, Rs, imm, rotate, shift_amount);
 
   // check_r15_lookahead(instr, op1);
   check_r15_lookahead(Rn, I, R, op1);
@@ -1882,7 +1729,7 @@ void RSC(ARM7TDMI* cpu, u32 opcode) {
   u32 rm_msb  = op2 & 0x80000000;
   u32 res_msb = result & 0x80000000;
 
-  if (S) {
+  if constexpr (S) {
     result >= 0x80000000 ? cpu->set_negative() : cpu->reset_negative();
     result == 0 ? cpu->set_zero() : cpu->reset_zero();
     op2 >= (op1 + (1 - old_carry)) ? cpu->set_carry() : cpu->reset_carry();
@@ -2163,64 +2010,50 @@ void LDRH(ARM7TDMI* cpu, u32 opcode) {  // TODO: implement writeback logic
   single_data_transfer_writeback_ldr(cpu, Rd, Rn, address, added_writeback_value, P, W);
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void CMP(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   u32 op1 = cpu->regs.get_reg(Rn);
   // op2 = cpu->handle_shifts(instr, false);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, false);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, false>(Rm, Rs, imm, rotate, shift_amount);
 
   u32 result = op1 - op2;
 
-  u32 rn_msb  = op1 & 0x80000000;
-  u32 rm_msb  = op2 & 0x80000000;
-  u32 res_msb = result & 0x80000000;
-
-  is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
-  is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
-  (rn_msb != rm_msb && rn_msb != res_msb) ? cpu->set_overflow() : cpu->reset_overflow();
-  (op1 >= op2) ? cpu->set_carry() : cpu->reset_carry();
+  cpu->regs.set_sub_flags(op1, op2, result);
 
   if (Rd == 15 && S) {
     cpu->regs.load_spsr_to_cpsr();
   }
 }
 
+template <bool I, bool S, bool R, u8 shift_type>
 void ORR(ARM7TDMI* cpu, u32 opcode) {
   u8 Rd           = (opcode & 0xf000) >> 12;
-  bool I          = opcode & (1 << 25);
-  bool S          = (opcode & (1 << 20));
   u8 Rm           = opcode & 0xf;
   u8 Rn           = (opcode & 0xf0000) >> 16;
   u8 Rs           = (opcode & 0xf00) >> 8;
-  bool R          = (opcode & (1 << 4));
   u8 imm          = opcode & 0xff;
   u8 rotate       = ((opcode & 0xf00) >> 8);
-  u8 shift_type   = (opcode & 0x60) >> 5;
   u8 shift_amount = (opcode & 0xf80) >> 7;
 
   u32 op1 = cpu->regs.get_reg(Rn);
   // op2 = cpu->handle_shifts(instr, S);
-  u32 op2 = cpu->handle_shifts(I, R, Rm, Rs, shift_type, imm, rotate, shift_amount, S, S);
+  u32 op2 = cpu->handle_shifts<I, R, shift_type, S, S>(Rm, Rs, imm, rotate, shift_amount);
 
   // check_r15_lookahead(instr, op1);
   check_r15_lookahead(Rn, I, R, op1);
 
   u32 result = op1 | op2;
 
-  if (S) {
-    is_zero(result) ? cpu->set_zero() : cpu->reset_zero();
-    is_negative(result) ? cpu->set_negative() : cpu->reset_negative();
+  if constexpr (S) {
+    cpu->regs.set_logical_flags(result);
 
     if (Rd == 15) {
       cpu->regs.load_spsr_to_cpsr();
@@ -2248,6 +2081,8 @@ void OP_MSR(ARM7TDMI* cpu, u32 opcode) {
   u32 op_value                = 0;
   PSR P                       = opcode & (1 << 22) ? SPSR_MODE : CPSR;
 
+  cpu->regs.sync_flags();  // the flag field write has to land on the real flags
+
   if (I == 0) {  // 0 = Register, 1 = Immediate
     op_value = cpu->regs.get_reg(Rm);
   } else {
@@ -2275,12 +2110,15 @@ void OP_MSR(ARM7TDMI* cpu, u32 opcode) {
         op_value |= 0x10;
 
         // fmt::println("[CPSR] new [c]ontrol field: {:#x}", op_value & 0x000000FF);
-        auto old_mode = cpu->regs.CPSR.STATE_BIT;
+        auto old_mode      = cpu->regs.CPSR.STATE_BIT;
+        auto old_bank_mode = cpu->regs.CPSR.MODE_BIT;
 
         cpu->regs.CPSR.value &= ~0x000000FF;
         cpu->regs.CPSR.value |= (op_value & 0x000000FF);
         cpu->regs.CPSR.value |= 0x10;
 
+        cpu->regs.switch_bank(old_bank_mode, cpu->regs.CPSR.MODE_BIT);
+
         if (old_mode != cpu->regs.CPSR.STATE_BIT) {
           cpu->flush_pipeline();
         }
@@ -2545,7 +2383,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
     if (!P && U) base_address += 0x40;
 
     if (S) {
-      cpu->regs.r[Rn] = base_address;
+      cpu->regs.user_reg(Rn) = base_address;
     } else {
       cpu->regs.get_reg(Rn) = base_address;
     }
@@ -2564,7 +2402,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
       // fmt::println("pre transfer: base is in reglist, setting r{} to {:#010x}", Rn, base_address);
 
       if (S) {
-        cpu->regs.r[Rn] = base_address;
+        cpu->regs.user_reg(Rn) = base_address;
       } else {
         cpu->regs.get_reg(Rn) = base_address;
       }
@@ -2576,7 +2414,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
       // if (Rn == r_num) { fmt::println("Rn{} IN STMDB: {:#010x}", +Rn, cpu->regs.get_reg(Rn)); }
 
       if (S) {
-        value = cpu->regs.r[r_num];
+        value = cpu->regs.user_reg(r_num);
         if (r_num == 15) {
           value = cpu->regs.r[15] + 4;
         }
@@ -2596,7 +2434,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
 
     if (W && !base_in_reg_list && U == 0) {
       if (S) {
-        cpu->regs.r[Rn] = (u32)(base_address - (Rlist_vec.size() * 4));
+        cpu->regs.user_reg(Rn) = (u32)(base_address - (Rlist_vec.size() * 4));
       } else {
         cpu->regs.get_reg(Rn) = (u32)(base_address - (Rlist_vec.size() * 4));
       }
@@ -2604,7 +2442,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
 
     if (W && !base_in_reg_list && U == 1) {
       if (S) {
-        cpu->regs.r[Rn] = base_address;
+        cpu->regs.user_reg(Rn) = base_address;
       } else {
         cpu->regs.get_reg(Rn) = base_address;
       }
@@ -2624,7 +2462,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
     // Writeback base immediately -- do not defer (quirk: needs reference)
     if (base_in_reg_list && W) {
       if (S) {
-        cpu->regs.r[Rn] = base_address + (Rlist_vec.size() * 4);
+        cpu->regs.user_reg(Rn) = base_address + (Rlist_vec.size() * 4);
       } else {
         cpu->regs.get_reg(Rn) = base_address + (Rlist_vec.size() * 4);
       }
@@ -2634,7 +2472,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
       // fmt::println("about to write the value of: r{}", r_num);
       base_address += 4;
       if (S) {  // Force write into user bank modes
-        value = cpu->regs.r[r_num];
+        value = cpu->regs.user_reg(r_num);
         if (r_num == 15) {
           value = cpu->regs.r[15] + 4;
         }
@@ -2660,7 +2498,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
 
     if (W && !base_in_reg_list) {
       if (S) {
-        cpu->regs.r[Rn] = base_address;
+        cpu->regs.user_reg(Rn) = base_address;
       } else {
         cpu->regs.get_reg(Rn) = base_address;
       }
@@ -2686,7 +2524,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
 
     if (base_in_reg_list && W) {
       if (S) {
-        cpu->regs.r[Rn] = base_address - (Rlist_vec.size() * 4);
+        cpu->regs.user_reg(Rn) = base_address - (Rlist_vec.size() * 4);
       } else {
         cpu->regs.get_reg(Rn) = base_address - (Rlist_vec.size() * 4);
       }
@@ -2699,7 +2537,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
       // fmt::println("about to write the value of: r{}", r_num);
       base_address += 4;
       if (S) {  // Write using values from user bank modes
-        value = cpu->regs.r[r_num];
+        value = cpu->regs.user_reg(r_num);
         if (r_num == 15) {
           value = cpu->regs.r[15] + 4;
         }
@@ -2717,7 +2555,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
 
     if (W && !base_in_reg_list) {
       if (S) {
-        cpu->regs.r[Rn] = base_address - (Rlist_vec.size() * 4);
+        cpu->regs.user_reg(Rn) = base_address - (Rlist_vec.size() * 4);
       } else {
         cpu->regs.get_reg(Rn) = base_address - (Rlist_vec.size() * 4);
       }
@@ -2736,7 +2574,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
   if (P == 0 && U == 1) {  // Post-increment (IA)
     if (base_in_reg_list && W) {
       if (S) {
-        cpu->regs.r[Rn] = base_address + (Rlist_vec.size() * 4);
+        cpu->regs.user_reg(Rn) = base_address + (Rlist_vec.size() * 4);
       } else {
         cpu->regs.get_reg(Rn) = base_address + (Rlist_vec.size() * 4);
       }
@@ -2747,7 +2585,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
     for (const auto& r_num : Rlist_vec) {  // REFACTOR: we are rechecking conditional multiple times
       // fmt::println("about to write the value of: r{}", r_num);
       if (S) {  // Force write into user bank modes
-        value = cpu->regs.r[r_num];
+        value = cpu->regs.user_reg(r_num);
         if (r_num == 15) {
           value = cpu->regs.r[15] + 4;
         }
@@ -2766,7 +2604,7 @@ void STM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {  // RE
 
     if (W && !base_in_reg_list) {
       if (S) {
-        cpu->regs.r[Rn] = base_address;
+        cpu->regs.user_reg(Rn) = base_address;
       } else {
         cpu->regs.get_reg(Rn) = base_address;
       }
@@ -2869,7 +2707,7 @@ void LDM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {
   for (const auto& r_num : Rlist_vec) {
     if (use_userbanks) {
       // fmt::println("using userbanks....");
-      cpu->regs.r[r_num] = cpu->bus->read32(operating_address + (pass * 4));
+      cpu->regs.user_reg(r_num) = cpu->bus->read32(operating_address + (pass * 4));
     } else {
       cpu->regs.get_reg(r_num) = cpu->bus->read32(operating_address + (pass * 4));
     }
@@ -2882,7 +2720,7 @@ void LDM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {
   if (W && !base_in_reg_list) {  // This is the deferred writeback, only executes if base register is not in register list.
     if (U == 0) {
       if (use_userbanks) {
-        cpu->regs.r[Rn] = address - (Rlist_vec.size() * 4);
+        cpu->regs.user_reg(Rn) = address - (Rlist_vec.size() * 4);
       } else {
         cpu->regs.get_reg(Rn) = address - (Rlist_vec.size() * 4);
       }
@@ -2890,7 +2728,7 @@ void LDM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {
 
     if (U == 1) {
       if (use_userbanks) {
-        cpu->regs.r[Rn] = address + (Rlist_vec.size() * 4);
+        cpu->regs.user_reg(Rn) = address + (Rlist_vec.size() * 4);
       } else {
         cpu->regs.get_reg(Rn) = address + (Rlist_vec.size() * 4);
       }
@@ -2901,7 +2739,7 @@ void LDM(ARM7TDMI* cpu, u32 opcode, bool lr_bit, bool thumb_load_store) {
 
   if (forced_writeback) {
     if (use_userbanks) {
-      cpu->regs.r[Rn] += 0x40;
+      cpu->regs.user_reg(Rn) += 0x40;
     } else {
       cpu->regs.get_reg(Rn) += 0x40;
     }
@@ -0,0 +1,248 @@
+#include "jit.hpp"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+JIT::JIT() {
+#if BASS_JIT_X64
+#ifdef _WIN32
+  code = static_cast<u8*>(VirtualAlloc(nullptr, CODE_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+#else
+  void* p = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  code    = p == MAP_FAILED ? nullptr : static_cast<u8*>(p);
+#endif
+#endif
+}
+
+JIT::~JIT() {
+  if (code == nullptr) return;
+#ifdef _WIN32
+  VirtualFree(code, 0, MEM_RELEASE);
+#else
+  munmap(code, CODE_BUFFER_SIZE);
+#endif
+}
+
+void JIT::reserve_block() {
+  if (offset + MAX_BLOCK_CODE_SIZE <= CODE_BUFFER_SIZE) return;
+
+  offset = 0;
+  epoch++;
+}
+
+void JIT::emit32(u32 v) {
+  std::memcpy(code + offset, &v, 4);
+  offset += 4;
+}
+
+void JIT::emit64(u64 v) {
+  std::memcpy(code + offset, &v, 8);
+  offset += 8;
+}
+
+// force is for spl/bpl/sil/dil, which are ah/ch/dh/bh without a prefix
+void JIT::rex(bool w, u8 reg, u8 base, bool force) {
+  u32 v = 0x40 | (w << 3) | ((reg >> 3) << 2) | (base >> 3);
+  if (v != 0x40 || force) emit8(v);
+}
+
+void JIT::modrm_mem(u8 reg, Reg base, i32 disp) {
+  bool short_disp = disp >= -128 && disp <= 127;
+
+  emit8((short_disp ? 0x40 : 0x80) | ((reg & 7) << 3) | (base & 7));
+  if ((base & 7) == RSP) emit8(0x24);  // rsp/r12 base needs a SIB byte
+
+  if (short_disp) {
+    emit8(static_cast<u32>(disp));
+  } else {
+    emit32(static_cast<u32>(disp));
+  }
+}
+
+void JIT::push(Reg r) {
+  rex(false, 0, r);
+  emit8(0x50 | (r & 7));
+}
+
+void JIT::pop(Reg r) {
+  rex(false, 0, r);
+  emit8(0x58 | (r & 7));
+}
+
+void JIT::call(const void* fn) {
+  mov64_imm(RAX, reinterpret_cast<u64>(fn));
+  emit8(0xFF);
+  emit8(0xD0);
+}
+
+void JIT::mov64(Reg dst, Reg src) {
+  rex(true, src, dst);
+  emit8(0x89);
+  emit8(0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+void JIT::mov64_imm(Reg dst, u64 imm) {
+  rex(true, 0, dst);
+  emit8(0xB8 | (dst & 7));
+  emit64(imm);
+}
+
+void JIT::mov32_imm(Reg dst, u32 imm) {
+  rex(false, 0, dst);
+  emit8(0xB8 | (dst & 7));
+  emit32(imm);
+}
+
+void JIT::load32(Reg dst, Reg base, i32 disp) {
+  rex(false, dst, base);
+  emit8(0x8B);
+  modrm_mem(dst, base, disp);
+}
+
+void JIT::load64(Reg dst, Reg base, i32 disp) {
+  rex(true, dst, base);
+  emit8(0x8B);
+  modrm_mem(dst, base, disp);
+}
+
+void JIT::load8_zx(Reg dst, Reg base, i32 disp) {
+  rex(false, dst, base);
+  emit8(0x0F);
+  emit8(0xB6);
+  modrm_mem(dst, base, disp);
+}
+
+void JIT::store32(Reg base, i32 disp, Reg src) {
+  rex(false, src, base);
+  emit8(0x89);
+  modrm_mem(src, base, disp);
+}
+
+void JIT::store64(Reg base, i32 disp, Reg src) {
+  rex(true, src, base);
+  emit8(0x89);
+  modrm_mem(src, base, disp);
+}
+
+void JIT::store32_imm(Reg base, i32 disp, u32 imm) {
+  rex(false, 0, base);
+  emit8(0xC7);
+  modrm_mem(0, base, disp);
+  emit32(imm);
+}
+
+void JIT::store8_imm(Reg base, i32 disp, u8 imm) {
+  rex(false, 0, base);
+  emit8(0xC6);
+  modrm_mem(0, base, disp);
+  emit8(imm);
+}
+
+void JIT::alu32(AluOp op, Reg dst, Reg src) {
+  rex(false, src, dst);
+  emit8((op << 3) | 1);
+  emit8(0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+void JIT::alu32_imm(AluOp op, Reg dst, u32 imm) {
+  rex(false, 0, dst);
+  emit8(0x81);
+  emit8(0xC0 | (op << 3) | (dst & 7));
+  emit32(imm);
+}
+
+void JIT::alu32_mem(AluOp op, Reg dst, Reg base, i32 disp) {
+  rex(false, dst, base);
+  emit8((op << 3) | 3);
+  modrm_mem(dst, base, disp);
+}
+
+void JIT::alu32_mem_imm(AluOp op, Reg base, i32 disp, u32 imm) {
+  rex(false, 0, base);
+  emit8(0x81);
+  modrm_mem(op, base, disp);
+  emit32(imm);
+}
+
+void JIT::alu64(AluOp op, Reg dst, Reg src) {
+  rex(true, src, dst);
+  emit8((op << 3) | 1);
+  emit8(0xC0 | ((src & 7) << 3) | (dst & 7));
+}
+
+void JIT::alu64_imm8(AluOp op, Reg dst, i8 imm) {
+  rex(true, 0, dst);
+  emit8(0x83);
+  emit8(0xC0 | (op << 3) | (dst & 7));
+  emit8(static_cast<u32>(imm));
+}
+
+void JIT::test32(Reg a, Reg b) {
+  rex(false, b, a);
+  emit8(0x85);
+  emit8(0xC0 | ((b & 7) << 3) | (a & 7));
+}
+
+void JIT::not32(Reg r) {
+  rex(false, 0, r);
+  emit8(0xF7);
+  emit8(0xD0 | (r & 7));
+}
+
+void JIT::shl32(Reg r, u8 amount) {
+  rex(false, 0, r);
+  emit8(0xC1);
+  emit8(0xE0 | (r & 7));
+  emit8(amount);
+}
+
+void JIT::shr32(Reg r, u8 amount) {
+  rex(false, 0, r);
+  emit8(0xC1);
+  emit8(0xE8 | (r & 7));
+  emit8(amount);
+}
+
+void JIT::bt32(Reg r, Reg bit) {
+  rex(false, bit, r);
+  emit8(0x0F);
+  emit8(0xA3);
+  emit8(0xC0 | ((bit & 7) << 3) | (r & 7));
+}
+
+void JIT::setcc(Cond c, Reg r) {
+  rex(false, 0, r, r >= RSP);
+  emit8(0x0F);
+  emit8(0x90 | c);
+  emit8(0xC0 | (r & 7));
+}
+
+void JIT::movzx8(Reg dst, Reg src) {
+  rex(false, dst, src, src >= RSP);
+  emit8(0x0F);
+  emit8(0xB6);
+  emit8(0xC0 | ((dst & 7) << 3) | (src & 7));
+}
+
+u8* JIT::jcc(Cond c) {
+  emit8(0x0F);
+  emit8(0x80 | c);
+  emit32(0);
+  return cursor() - 4;
+}
+
+u8* JIT::jmp() {
+  emit8(0xE9);
+  emit32(0);
+  return cursor() - 4;
+}
+
+void JIT::patch(u8* displacement, const u8* target) {
+  i32 rel = static_cast<i32>(target - (displacement + 4));
+  std::memcpy(displacement, &rel, 4);
+}
@@ -10,10 +10,10 @@
 
 // TODO: use direct VRAM access instead of bus read function. this avoids cycle counting, and reduces overhead
 
-// 16 colors (each color being 2 bytes)
-static constexpr u8 BANK_SIZE                = 16 * 2;
 static constexpr u32 SCREEN_WIDTH            = 512;
 static constexpr u32 BITMAP_MODE_PAGE_OFFSET = 0xA000;
+static constexpr Tile BLANK_TILE             = {};
+static constexpr u32 VISIBLE_TILES_PER_LINE  = (240 / 8) + 1;  // a scrolled line straddles one extra tile
 
 bool PPU::is_valid_obj(const OAM_Entry& oam_entry) {
   if (oam_entry.obj_mode == OBJ_MODE::PROHIBITED) return false;
@@ -23,59 +23,134 @@ bool PPU::is_valid_obj(const OAM_Entry& oam_entry) {
   return true;
 }
 
-void PPU::repopulate_objs() {
-  u8 index = 0;
-  for (const auto& entry : entries) {
-    if (!is_valid_obj(entry)) {
-      index++;
-      continue;
-    }
+u32 PPU::get_obj_tile_id(const OAM_Entry& entry, u32 tile_x, u32 tile_y) {
+  if (display_fields.DISPCNT.OBJ_CHAR_VRAM_MAPPING == Bus::ONE_DIMENSIONAL) {
+    u32 obj_width = get_obj_width(entry);
+    if (entry.color_depth == COLOR_DEPTH::BPP8) return entry.char_name + (tile_x + (tile_y * obj_width)) * 2;
 
-    Tile current_tile;
+    return entry.char_name + (tile_x + (tile_y * obj_width));
+  }
 
-    u16 obj_height = get_obj_height(entry);  // height of OBJ in tiles
-    u16 obj_width  = get_obj_width(entry);   // width of OBJ in tiles
+  return (entry.char_name + tile_x + (tile_y * 32)) % 1024;
+}
 
-    u32 current_charname = 0;  // Tile ID
+bool PPU::obj_uses_dirty_tile(const OAM_Entry& entry) {
+  u32 tiles_per_id = entry.color_depth == COLOR_DEPTH::BPP8 ? 2 : 1;
 
-    for (size_t tile_y = 0; tile_y < obj_height; tile_y++) {
-      for (size_t tile_x = 0; tile_x < obj_width; tile_x++) {
-        if (display_fields.DISPCNT.OBJ_CHAR_VRAM_MAPPING == Bus::ONE_DIMENSIONAL) {
-          current_charname = entry.char_name + (tile_x + (tile_y * obj_width));
-          if (entry.color_depth == COLOR_DEPTH::BPP8) current_charname = entry.char_name + (tile_x + (tile_y * obj_width)) * 2;
+  for (u32 tile_y = 0; tile_y < get_obj_height(entry); tile_y++) {
+    for (u32 tile_x = 0; tile_x < get_obj_width(entry); tile_x++) {
+      u32 tile_id = get_obj_tile_id(entry, tile_x, tile_y);
 
-        } else {
-          current_charname = (entry.char_name + tile_x + (tile_y * 32)) % 1024;
-        }
+      for (u32 i = 0; i < tiles_per_id; i++) {
+        if (state.obj_tile_dirty[(tile_id + i) % 1024]) return true;
+      }
+    }
+  }
+
+  return false;
+}
 
-        current_tile = get_obj_tile_by_tile_index(current_charname, entry.color_depth);
+void PPU::decode_obj(u8 index) {
+  const OAM_Entry& entry = entries[index];
 
-        for (size_t y = 0; y < 8; y++) {
-          for (size_t x = 0; x < 8; x++) {
-            objs[index].data.at((tile_x * 8) + (tile_y * (64 * 8)) + ((y * 64) + x)) = current_tile.at((y * 8) + x);
-          }
+  u16 obj_height = get_obj_height(entry);  // height of OBJ in tiles
+  u16 obj_width  = get_obj_width(entry);   // width of OBJ in tiles
+
+  for (u32 tile_y = 0; tile_y < obj_height; tile_y++) {
+    for (u32 tile_x = 0; tile_x < obj_width; tile_x++) {
+      const Tile& current_tile = get_obj_tile_by_tile_index(static_cast<u16>(get_obj_tile_id(entry, tile_x, tile_y)), entry.color_depth);
+
+      for (size_t y = 0; y < 8; y++) {
+        for (size_t x = 0; x < 8; x++) {
+          objs[index].data.at((tile_x * 8) + (tile_y * (64 * 8)) + ((y * 64) + x)) = current_tile.at((y * 8) + x);
         }
       }
     }
+  }
 
-    if (entry.horizontal_flip == FLIP::MIRRORED) {
-      for (u8 y = 0; y < get_obj_height(entry) * 8; y++) {
-        std::reverse(std::begin(objs[index].data) + (y * 64), std::begin(objs[index].data) + (y * 64) + get_obj_width(entry) * 8);
+  if (entry.horizontal_flip == FLIP::MIRRORED) {
+    for (u8 y = 0; y < get_obj_height(entry) * 8; y++) {
+      std::reverse(std::begin(objs[index].data) + (y * 64), std::begin(objs[index].data) + (y * 64) + get_obj_width(entry) * 8);
+    }
+  }
+
+  if (entry.vertical_flip == FLIP::MIRRORED) {
+    std::array<u8, 64 * 64> tmp = {};
+    for (u8 y = 0; y > get_obj_height(entry) * 8; y++) {
+      for (u8 x = 0; x < 64; x++) {
+        std::copy(std::begin(objs[index].data) + (y * 64), std::begin(objs[index].data) + (y * 64) + 64, std::begin(tmp) + ((64 - y) * 64));
       }
     }
+    objs[index].data = tmp;
+  }
+}
+
+void PPU::rebuild_obj_lines() {
+  obj_line_count.fill(0);
+
+  for (u8 index = 0; index < 128; index++) {
+    const OAM_Entry& entry = entries[index];
+    if (!is_valid_obj(entry)) continue;
+
+    u32 height = get_obj_height(entry) * 8;
+
+    for (u32 y = 0; y < height; y++) {
+      u32 line = (entry.y + y) % 256;
+      if (line >= 160) continue;
+
+      obj_lines[line][obj_line_count[line]++] = index;
+    }
+  }
+}
 
-    if (entry.vertical_flip == FLIP::MIRRORED) {
-      std::array<u8, 64 * 64> tmp = {};
-      for (u8 y = 0; y > get_obj_height(entry) * 8; y++) {
-        for (u8 x = 0; x < 64; x++) {
-          std::copy(std::begin(objs[index].data) + (y * 64), std::begin(objs[index].data) + (y * 64) + 64, std::begin(tmp) + ((64 - y) * 64));
-        }
+void PPU::repopulate_objs() {
+  std::bitset<128> redraw = {};  // entries that need a redraw even if their attributes are unchanged
+
+  if (state.mapping_mode_changed) {
+    redraw.set();
+    state.mapping_mode_changed = false;
+  }
+
+  // affine sprites get re-rendered when their parameter group changes
+  if (state.oam_affine_dirty.any()) {
+    for (u8 index = 0; index < 128; index++) {
+      if (entries[index].rotation_scaling_flag && state.oam_affine_dirty[get_obj_affine_group(entries[index])]) redraw[index] = true;
+    }
+    state.oam_affine_dirty.reset();
+  }
+
+  // entries whose attributes didn't change still need a redraw when one of their tiles got written to
+  if (state.obj_tiles_changed) {
+    for (u8 index = 0; index < 128; index++) {
+      if (!redraw[index] && is_valid_obj(entries[index]) && obj_uses_dirty_tile(entries[index])) redraw[index] = true;
+    }
+    state.obj_tile_dirty.reset();
+    state.obj_tiles_changed = false;
+  }
+
+  state.oam_changed = false;
+
+  bool layout_changed = false;
+
+  for (u8 index = 0; index < 128; index++) {
+    if (state.oam_entry_dirty[index]) {
+      u64 v = *(u64*)(&bus->OAM[index * 8]);
+
+      // OAM DMA rewrites every entry each frame, most of them with the same attributes
+      if ((v ^ entries[index].v) & 0x0000FFFFFFFFFFFF) {  // attr3 doesn't affect the entry itself
+        layout_changed = true;
+        redraw[index]  = true;
       }
-      objs[index].data = tmp;
+
+      entries[index].v = v;
     }
 
-    index++;
+    if (redraw[index] && is_valid_obj(entries[index])) decode_obj(index);
   }
+
+  state.oam_entry_dirty.reset();
+
+  if (layout_changed) rebuild_obj_lines();
 }
 
 u8 PPU::get_obj_height(const OAM_Entry& c) {
@@ -173,29 +248,30 @@ u8 PPU::get_obj_width(const OAM_Entry& c) {
   return -1;
 };
 
-u32 PPU::get_color_by_index(u8 x, u8 palette_num, COLOR_DEPTH color_depth) const {
-  u16 color_index;
+// the colour a layer colour shows as, for the debugger's textures
+static u32 host_color(u32 color) { return BGR555_TO_RGB888_LUT[color & 0x7FFF]; }
 
-  if (color_depth == COLOR_DEPTH::BPP8) {
-    color_index = bus->read16(PALETTE_RAM_BG_BASE + (x * 2));
-  } else {
-    color_index = bus->read16(PALETTE_RAM_BG_BASE + (x * 2) + (0x20 * palette_num));
-  }
+void PPU::update_palette_entry(u32 entry) {
+  const u16 color = *(u16*)(&PALETTE_RAM[entry * 2]) & 0x7FFF;
 
-  return BGR555_TO_RGB888_LUT[color_index];
+  palette[entry] = (entry << PALETTE_ENTRY_SHIFT) | color;
+  if (palette_fades_stale) return;
+
+  palette_brighter[entry] = BGR555_TO_RGB888_LUT[adjust_brightness(color, palette_evy, true)];
+  palette_darker[entry]   = BGR555_TO_RGB888_LUT[adjust_brightness(color, palette_evy, false)];
 }
 
-u32 PPU::get_obj_color_by_index(u8 palette_index, u8 bank_number, COLOR_DEPTH color_depth) const {
-  u16 color_index = 0;
+void PPU::set_brightness(u8 evy) {
+  evy = std::min<u8>(evy, 16);  // anything above 16 acts as 16
+  if (evy == palette_evy) return;
 
-  if (color_depth == COLOR_DEPTH::BPP8) {
-    color_index = bus->read16(PALETTE_RAM_OBJ_BASE + (palette_index * 2));
-  } else {
-    assert(palette_index <= 15);
-    color_index = bus->read16(PALETTE_RAM_OBJ_BASE + (palette_index * 2) + (BANK_SIZE * bank_number));
-  }
+  palette_evy         = evy;
+  palette_fades_stale = true;
+}
 
-  return BGR555_TO_RGB888_LUT[color_index];
+void PPU::refresh_palette_fades() {
+  palette_fades_stale = false;
+  for (u32 entry = 0; entry < PALETTE_ENTRIES; entry++) update_palette_entry(entry);
 }
 
 std::tuple<u16, u16> PPU::get_text_bg_offset(u8 bg_id) const {
@@ -235,54 +311,40 @@ std::tuple<u8, u8> PPU::get_affine_bg_tile_sizes(u8 bg_id) {
   return {};
 }
 
-void PPU::load_tiles(u8 bg, const COLOR_DEPTH color_depth) {
-  ppu_logger->debug("loading tiles");
-  // assert(color_depth < 2);
-  u8 x = 0;
-  Tile tile;
-  u32 rel_cbb = relative_cbb(bg);
+const Tile& PPU::get_cached_tile(u32 vram_offset, const COLOR_DEPTH color_depth) {
+  u8 depth   = static_cast<u8>(color_depth);
+  u32 unit   = vram_offset / TILE_UNIT_SIZE;
+  Tile& tile = tile_cache[depth][unit];
 
-  if (color_depth == COLOR_DEPTH::BPP4) {
-    for (size_t tile_index = 0; tile_index < 1024; tile_index++) {
-      for (size_t byte = 0; byte < 32; byte++) {
-        tile.at((byte * 2) + x)       = VRAM[rel_cbb + (tile_index * 0x20) + byte] & 0x0F;         // X = 0
-        tile.at((byte * 2) + (x + 1)) = (VRAM[rel_cbb + (tile_index * 0x20) + byte] & 0xF0) >> 4;  // X = 1
-      }
+  if (!tile_dirty[depth][unit]) return tile;
 
-      tile_sets[bg][tile_index] = tile;
+  if (color_depth == COLOR_DEPTH::BPP4) {
+    for (size_t byte = 0; byte < 0x20; byte++) {
+      u8 v                 = VRAM[vram_offset + byte];
+      tile[(byte * 2)]     = v & 0x0F;         // X = 0
+      tile[(byte * 2) + 1] = (v & 0xF0) >> 4;  // X = 1
     }
   } else {
-    for (size_t tile_index = 0; tile_index < 1024; tile_index++) {
-      for (size_t byte = 0; byte < 64; byte++) {
-        tile[byte] = VRAM[rel_cbb + (tile_index * 0x40) + byte];
-      }
-
-      tile_sets[bg][tile_index] = tile;
+    for (size_t byte = 0; byte < 0x40; byte++) {
+      tile[byte] = (vram_offset + byte) < VRAM.size() ? VRAM[vram_offset + byte] : 0;  // last OBJ tile runs off the end of VRAM
     }
   }
+
+  tile_dirty[depth][unit] = false;
+  return tile;
 }
 
-Tile PPU::get_obj_tile_by_tile_index(u16 tile_id, COLOR_DEPTH color_mode) {
-  // u8 x = 0;
-  Tile tile;
+const Tile& PPU::get_bg_tile(u8 bg, u16 tile_index, const COLOR_DEPTH color_depth) {
+  u32 offset = relative_cbb(bg) + (tile_index * (color_depth == COLOR_DEPTH::BPP4 ? 0x20u : 0x40u));
 
-  switch (color_mode) {
-    case COLOR_DEPTH::BPP4: {
-      for (size_t byte = 0; byte < 0x20; byte++) {
-        tile[(byte * 2)]     = VRAM[OBJ_DATA_OFFSET + (tile_id * 0x20) + byte] & 0x0F;         // X = 0
-        tile[(byte * 2) + 1] = (VRAM[OBJ_DATA_OFFSET + (tile_id * 0x20) + byte] & 0xF0) >> 4;  // X = 1
-      }
-      break;
-    }
-    case COLOR_DEPTH::BPP8: {
-      for (size_t byte = 0; byte < 0x40; byte++) {
-        tile[byte] = VRAM[OBJ_DATA_OFFSET + (tile_id * 0x20) + byte];
-      }
-      break;
-    }
-  }
+  // BG tiles can't be fetched from the OBJ half of VRAM
+  if (offset >= OBJ_DATA_OFFSET) return BLANK_TILE;
 
-  return tile;
+  return get_cached_tile(offset, color_depth);
+}
+
+const Tile& PPU::get_obj_tile_by_tile_index(u16 tile_id, COLOR_DEPTH color_mode) {
+  return get_cached_tile(OBJ_DATA_OFFSET + ((tile_id % 1024) * 0x20), color_mode);
 }
 
 inline u32 PPU::absolute_sbb(u8 bg, u8 map_x) {
@@ -308,6 +370,96 @@ inline u32 PPU::relative_cbb(u8 bg) {
   assert(0);
   return 0x0;
 }
+inline u32 PPU::relative_sbb(u8 bg) { return absolute_sbb(bg) - VRAM_BASE; }
+
+ScreenBlockEntryMode0 PPU::get_text_screen_entry(u8 bg, u8 screen_size, u32 tile_x, u32 tile_y) {
+  // 64 tile wide maps put the right hand screenblock directly after the left one, the bottom half follows after those
+  u32 block = (tile_x / 32) + ((tile_y / 32) * (screen_size & 1 ? 2 : 1));
+  u32 addr  = relative_sbb(bg) + (block * 0x800) + (((tile_x % 32) + ((tile_y % 32) * 32)) * 2);
+
+  return ScreenBlockEntryMode0{.v = *(u16*)(&VRAM[addr])};
+}
+
+// Reads the row of each tile straight out of VRAM, 8 pixels in one load. Flips are done on the loaded row:
+// vertical picks the mirrored row, horizontal reverses the bytes (8bpp) or the nibbles (4bpp).
+void PPU::render_text_bg_span(u8 bg, u8 screen_size, COLOR_DEPTH color_depth, u32 map_x, u32 map_y, u32 count, u8* index, bool* opaque) {
+  const u32 width = std::get<0>(get_render_offset(screen_size));
+
+  const u32 cbb    = relative_cbb(bg);
+  const u32 tile_y = map_y / 8;
+  const u32 y      = map_y % 8;
+
+  for (u32 x = 0; x < count;) {
+    const u32 px                      = (map_x + x) % width;
+    const u32 first                   = px % 8;
+    const u32 n                       = std::min(8 - first, count - x);
+    const ScreenBlockEntryMode0 entry = get_text_screen_entry(bg, screen_size, px / 8, tile_y);
+    const u32 row                     = entry.VERTICAL_FLIP ? 7 - y : y;
+
+    if (color_depth == COLOR_DEPTH::BPP8) {
+      const u32 tile = cbb + (entry.tile_index * 0x40);
+      u64 pixels     = tile < OBJ_DATA_OFFSET ? *(u64*)(&VRAM[tile + (row * 8)]) : 0;  // BG tiles can't come from OBJ VRAM
+
+      if (entry.HORIZONTAL_FLIP) pixels = __builtin_bswap64(pixels);
+      pixels >>= first * 8;
+
+      for (u32 i = 0; i < n; i++, pixels >>= 8) {
+        index[x + i]  = static_cast<u8>(pixels);
+        opaque[x + i] = (pixels & 0xFF) != 0;
+      }
+    } else {
+      const u32 tile = cbb + (entry.tile_index * 0x20);
+      u32 pixels     = tile < OBJ_DATA_OFFSET ? *(u32*)(&VRAM[tile + (row * 4)]) : 0;
+
+      if (entry.HORIZONTAL_FLIP) {
+        pixels = __builtin_bswap32(pixels);
+        pixels = ((pixels & 0x0F0F0F0F) << 4) | ((pixels >> 4) & 0x0F0F0F0F);
+      }
+      pixels >>= first * 4;
+
+      const u8 bank = static_cast<u8>(entry.PAL_BANK << 4);
+      for (u32 i = 0; i < n; i++, pixels >>= 4) {
+        index[x + i]  = bank | (pixels & 0xF);
+        opaque[x + i] = (pixels & 0xF) != 0;
+      }
+    }
+
+    x += n;
+  }
+}
+
+void PPU::render_text_bg_scanline(u8 bg, u8 screen_size, COLOR_DEPTH color_depth) {
+  auto [x_offset, y_offset]               = get_text_bg_offset(bg);
+  auto [x_render_offset, y_render_offset] = get_render_offset(screen_size);
+
+  const u32 map_y = (display_fields.VCOUNT.LY + y_offset) % y_render_offset;
+
+  const BgLine& line = bg_lines[bg];
+  render_text_bg_span(bg, screen_size, color_depth, x_offset % x_render_offset, map_y, SYSTEM_DISPLAY_WIDTH, bg_lines[bg].index.data(), bg_lines[bg].opaque.data());
+
+  LayerLine& layer = layer_lines[LAYER_BG0 + bg];
+  layer.prio.fill(get_bg_prio(bg));
+
+  for (u32 x = 0; x < SYSTEM_DISPLAY_WIDTH; x++) {
+    layer.color[x]  = palette[line.index[x]];
+    layer.opaque[x] = line.opaque[x] ? 0xFF : 0;
+  }
+}
+
+void PPU::render_text_bg_texture(u8 bg) {
+  const auto& cnt = bg == 0 ? display_fields.BG0CNT : bg == 1 ? display_fields.BG1CNT : bg == 2 ? display_fields.BG2CNT : display_fields.BG3CNT;
+  auto [width, height] = get_render_offset(cnt.SCREEN_SIZE);
+
+  std::array<u8, 512> index    = {};
+  std::array<bool, 512> opaque = {};
+
+  for (u32 map_y = 0; map_y < height; map_y++) {
+    render_text_bg_span(bg, cnt.SCREEN_SIZE, cnt.color_depth, 0, map_y, width, index.data(), opaque.data());
+
+    for (u32 x = 0; x < width; x++) tile_map_texture_buffer_arr[bg][(map_y * SCREEN_WIDTH) + x] = host_color(palette[index[x]]);
+  }
+}
+
 bool PPU::background_enabled(u8 bg_id) {
   switch (bg_id) {
     case 0: return (display_fields.DISPCNT.SCREEN_DISPLAY_BG0);
@@ -319,450 +471,403 @@ bool PPU::background_enabled(u8 bg_id) {
   assert(0);
   return false;
 }
-void PPU::step() {
-  // TODO: This should be a scanline renderer, at the start of each scanline 1 scanline should be written to the framebuffer.
-  //       At VBLANK, the framebuffer should be copied by whatever frontend and drawn onto the screen.
-  switch (display_fields.DISPCNT.BG_MODE) {
-    case MODE_0: {
-      const auto& LY = display_fields.VCOUNT.LY;
+bool PPU::bg_mosaic_enabled(u8 bg_id) const {
+  switch (bg_id) {
+    case 0: return display_fields.BG0CNT.MOSAIC;
+    case 1: return display_fields.BG1CNT.MOSAIC;
+    case 2: return display_fields.BG2CNT.MOSAIC;
+    case 3: return display_fields.BG3CNT.MOSAIC;
+  }
 
-      // TODO: do we really need this on the stack each single time?
-      std::array<u8, 4> screen_sizes = {
-          display_fields.BG0CNT.SCREEN_SIZE,
-          display_fields.BG1CNT.SCREEN_SIZE,
-          display_fields.BG2CNT.SCREEN_SIZE,
-          display_fields.BG3CNT.SCREEN_SIZE,
-      };
-      std::array<COLOR_DEPTH, 4> bg_bpp = {
-          display_fields.BG0CNT.color_depth,
-          display_fields.BG1CNT.color_depth,
-          display_fields.BG2CNT.color_depth,
-          display_fields.BG3CNT.color_depth,
-      };
+  assert(0);
+  return false;
+}
 
-      // process bgs
-      for (u8 bg = 0; bg < 4; bg++) {
-        if (!background_enabled(bg)) continue;
+// horizontal mosaic, every block of size pixels (counted from the left edge of the screen) repeats its first one
+static void mosaic_layer_line(LayerLine& layer, u32 size) {
+  for (u32 x = 0; x < LINE_WIDTH; x += size) {
+    const u32 end = std::min(x + size, LINE_WIDTH);
 
-        auto [x_offset, y_offset] = get_text_bg_offset(bg);
+    std::fill(layer.color.begin() + x + 1, layer.color.begin() + end, layer.color[x]);
+    std::fill(layer.prio.begin() + x + 1, layer.prio.begin() + end, layer.prio[x]);
+    std::fill(layer.opaque.begin() + x + 1, layer.opaque.begin() + end, layer.opaque[x]);
+  }
+}
 
-        // load tiles into tilesets from charblocks
+bool PPU::bg_mosaic_hold(u8 bg) {
+  const auto& LY = display_fields.VCOUNT.LY;
+  const u32 size = display_fields.MOSAIC.BG_MOSAIC_V_SIZE + 1u;
 
-        load_tiles(bg, bg_bpp[bg]);  // only gets called when dispstat corresponding to bg changes
+  if (!bg_mosaic_enabled(bg) || size == 1 || (LY % size) == 0) return false;
+  if (mosaic_source_line[bg] != LY - (LY % size)) return false;  // the block's first line wasn't rendered, this one takes its place
 
-        // Load screenblocks to our background tile map
-        switch (screen_sizes[bg]) {
-          case 0: {
-            // [0]
-            u8 map_x = 0;
-            // let's calculate tile y beforehand...
-            u8 tile_y = ((LY + y_offset) % 256) / 8;
+  // colour and priority are untouched since, only the window pass wrote to the opaque mask
+  layer_lines[LAYER_BG0 + bg].opaque = mosaic_opaque[bg];
+  return true;
+}
 
-            // TODO: probably shouldn't re-populate screenblock entry map every single scanline -- expensive
-            for (u32 tile_x = 0; tile_x < 32; tile_x++) {
-              u32 dest = (tile_y * 64) + tile_x;
+void PPU::bg_mosaic_finish(u8 bg) {
+  const auto& LY = display_fields.VCOUNT.LY;
 
-              tile_maps[bg][dest] = ScreenBlockEntryMode0{
-                  .v = bus->read16(absolute_sbb(bg, map_x) + ((tile_x + (tile_y * 32)) * 2)),  // should be able to directly access vram, bus adds alot of overhead
+  if (!bg_mosaic_enabled(bg)) {
+    mosaic_source_line[bg] = NO_MOSAIC_LINE;
+    return;
+  }
 
-              };
-            }
-            break;
-          }
-          case 1: {
-            // [0][1]
-
-            for (u32 map_x = 0; map_x < 2; map_x++) {
-              for (u32 tile_y = 0; tile_y < 32; tile_y++) {
-                for (u32 tile_x = 0; tile_x < 32; tile_x++) {
-                  u32 dest = (tile_y * 64) + tile_x + (map_x * 32);
-
-                  tile_maps[bg][dest] = ScreenBlockEntryMode0{
-                      .v = bus->read16(absolute_sbb(bg, map_x) + ((tile_x + (tile_y * 32)) * 2)),
-                  };
-                }
-              }
-            };
-            break;
-          }
-          case 2: {
-            // [0]
-            // [1]
-            for (u32 map_x = 0; map_x < 2; map_x++) {
-              for (u32 tile_y = 0; tile_y < 32; tile_y++) {
-                for (u32 tile_x = 0; tile_x < 32; tile_x++) {
-                  u32 dest = (tile_y * 64) + tile_x + (map_x * (32 * 64));
-
-                  tile_maps[bg][dest] = ScreenBlockEntryMode0{
-                      .v = bus->read16(absolute_sbb(bg, map_x) + ((tile_x + (tile_y * 32)) * 2)),
-                  };
-                }
-              }
-            };
-            break;
-          }
-          case 3: {
-            // [0][1]
-            // [2][3]
-            for (u32 map_x = 0; map_x < 4; map_x++) {
-              for (u32 tile_y = 0; tile_y < 32; tile_y++) {
-                for (u32 tile_x = 0; tile_x < 32; tile_x++) {
-                  u32 dest = (tile_y * 64) + tile_x + (map_x * 32);
-
-                  if (map_x == 2) {
-                    dest = (tile_y * 64) + tile_x + (64 * 32);
-                  }
-                  if (map_x == 3) {
-                    dest = (tile_y * 64) + tile_x + (64 * 32) + (32);
-                  }
-
-                  tile_maps[bg][dest] = ScreenBlockEntryMode0{
-                      .v = bus->read16(absolute_sbb(bg, map_x) + ((tile_x + (tile_y * 32)) * 2)),
-                  };
-                }
-              }
-            };
-            // assert(0);
-            break;
-          }
-        }
+  const u32 h_size = display_fields.MOSAIC.BG_MOSAIC_H_SIZE + 1u;
+  const u32 v_size = display_fields.MOSAIC.BG_MOSAIC_V_SIZE + 1u;
 
-        auto [x_render_offset, y_render_offset] = get_render_offset(screen_sizes[bg]);
+  if (h_size > 1) mosaic_layer_line(layer_lines[LAYER_BG0 + bg], h_size);
 
-        // write scanlines to the buffers
-        u8 tile_y = ((LY + y_offset) % y_render_offset) / 8;
-        u8 y      = ((LY + y_offset) % y_render_offset) % 8;
+  // saved even with a V size of 1, MOSAIC can change before the next line and make this one a block's first
+  mosaic_source_line[bg] = static_cast<u16>(LY - (LY % v_size));
+  mosaic_opaque[bg]      = layer_lines[LAYER_BG0 + bg].opaque;
+}
 
-        for (size_t tile_x = 0; tile_x < 64; tile_x++) {
-          const ScreenBlockEntryMode0& entry = tile_maps[bg][(tile_y * 64) + tile_x];
-          Tile tile                          = tile_sets[bg][entry.tile_index];
+void PPU::draw_backdrop_scanline() {
+  const auto& LY = display_fields.VCOUNT.LY;
 
-          // OBJ are now flipped on a individual level, but the order of OBJ is what needs to be flipped, (including the OBJ being flipped)
-          if (entry.VERTICAL_FLIP) {
-            Tile tb;
+  const u32 color = host_color(get_color_by_index(0, 0, COLOR_DEPTH::BPP4));
 
-            for (size_t row = 0; row < 8; row++) {  // TODO: move into func
-              for (size_t pix_n = 0; pix_n < 8; pix_n++) {
-                tb[(row * 8) + pix_n] = tile[((7 - row) * 8) + pix_n];
-              }
-            }
+  std::fill_n(&backdrop[LY * SYSTEM_DISPLAY_WIDTH], SYSTEM_DISPLAY_WIDTH, color);
+}
 
-            tile = tb;
-          }
-          if (entry.HORIZONTAL_FLIP) {
-            for (size_t row = 0; row < 8; row++) {  // TODO: move into func
-              std::reverse(tile.begin() + (row * 8), (tile.begin() + 8 + (row * 8)));
-            }
-          }
+void PPU::render_obj_scanline() {
+  const auto& LY   = display_fields.VCOUNT.LY;
+  LayerLine& layer = layer_lines[LAYER_OBJ];
 
-          // setting up tile map
-          for (size_t x = 0; x < 8; x++) {
-            auto clr = get_color_by_index(tile[(y * 8) + x], entry.PAL_BANK, bg_bpp[bg]);
+  layer.opaque.fill(0);
+  obj_window.fill(0);
+  obj_semi_transparent.fill(0);
+  line_has_semi_transparent_obj = false;
 
-            // Palette Index = 0 -- if so save entry in the transparency map. Used during composition
-            transparency_maps[bg][((tile_y * (SCREEN_WIDTH * 8)) + (y * SCREEN_WIDTH) + ((tile_x * 8) + x))] = ((tile[(y * 8) + x] == 0));
+  // process sprites, only entries touched since the last line get re-decoded
+  if (state.oam_changed || state.obj_tiles_changed || state.mapping_mode_changed) repopulate_objs();
 
-            tile_map_texture_buffer_arr[bg][((tile_y * (SCREEN_WIDTH * 8)) + (y * SCREEN_WIDTH) + ((tile_x * 8) + x))] = clr;
-          }
-        }
+  const u32 mosaic_h_size = display_fields.MOSAIC.OBJ_MOSAIC_H_SIZE + 1u;
+  const u32 mosaic_y      = LY % (display_fields.MOSAIC.OBJ_MOSAIC_V_SIZE + 1u);  // lines since the vertical mosaic block began
 
-        // if (LY > 159) continue;
-        //  In case that some or all BGs are set to same priority then BG0 is having the highest, and BG3 the lowest priority.
-      }
+  // the list is in OAM order, the first opaque pixel is the one that shows (whatever its priority)
+  for (u8 i = 0; i < obj_line_count[LY]; i++) {
+    const u8 entry_idx         = obj_lines[LY][i];
+    const OAM_Entry& oam_entry = entries.at(entry_idx);
 
-      if (LY > 159) return;
+    u16 y_relative_to_top_of_obj = (((i16)LY - (i16)oam_entry.y) + 256) % 256;
 
-      const bool draw_sprites = display_fields.DISPCNT.SCREEN_DISPLAY_OBJ;
+    auto obj_width = get_obj_width(oam_entry);
 
-      // ====================================  composition ====================================
-      std::vector<Item> active_bgs = {};
+    // mosaic: the row of the first line of the block (or the top row, if the block began above the OBJ), and
+    // each pixel repeats the first one of its block. block tracks the position within it, so no division per pixel
+    u32 block_size = 1;
+    u32 block      = 0;
 
-      // determine priority
-      for (int bg = 3; bg >= 0; bg--) {
-        if (!background_enabled(bg)) {
-          continue;
-        }
-        active_bgs.emplace_back(static_cast<u8>(bg), get_bg_prio(bg));
-      }
+    if (oam_entry.obj_mosaic) {
+      const i32 screen_x = oam_entry.x >= 240 ? oam_entry.x - 512 : oam_entry.x;
 
-      std::ranges::stable_sort(active_bgs, [](const Item& a, const Item& b) {
-        if (a.bg_prio != b.bg_prio) return a.bg_prio > b.bg_prio;  // primary
-        return a.bg_id > b.bg_id;                                  // tiebreaker
-      });
+      y_relative_to_top_of_obj = y_relative_to_top_of_obj >= mosaic_y ? static_cast<u16>(y_relative_to_top_of_obj - mosaic_y) : 0;
+      block_size               = mosaic_h_size;
+      block                    = static_cast<u32>(((screen_x % static_cast<i32>(block_size)) + static_cast<i32>(block_size)) % static_cast<i32>(block_size));
+    }
 
-      // draw backdrop
-      for (size_t x = 0; x < 240; x++) {
-        backdrop[(LY * SYSTEM_DISPLAY_WIDTH) + x] = get_color_by_index(0, 0, COLOR_DEPTH::BPP4);
-        auto& bg_pixel                            = background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x);
+    const bool window_obj = oam_entry.obj_mode == OBJ_MODE::OBJ_WINDOW;
+    const u8 semi         = oam_entry.obj_mode == OBJ_MODE::SEMI_TRANSPARENT ? 0xFF : 0;
 
-        bg_pixel.prio  = 5;
-        bg_pixel.color = get_color_by_index(0, 0, COLOR_DEPTH::BPP4);
-      }
+    line_has_semi_transparent_obj |= semi != 0;
 
-      for (const auto& bg : active_bgs) {
-        // fmt::println("BG ID: {}", bg.bg_id);
-        auto [x_offset, y_offset]               = get_text_bg_offset(bg.bg_id);
-        auto [x_render_offset, y_render_offset] = get_render_offset(screen_sizes[bg.bg_id]);
-        for (size_t x = 0; x < 240; x++) {
-          u32 complete_x_offset = (x + x_offset) % x_render_offset;
-          u32 complete_y_offset = ((LY + y_offset) % y_render_offset) * 512;
+    for (u32 x = 0; x < obj_width * 8u; x++) {
+      const u32 src_x = x - std::min(x, block);
+      if (++block == block_size) block = 0;
 
-          assert((complete_x_offset + complete_y_offset) < (512 * 512));
+      const auto& palette_index_of_pixel = objs[entry_idx].data.at(((y_relative_to_top_of_obj) * 64) + src_x);
 
-          if (transparency_maps[bg.bg_id][(complete_x_offset + complete_y_offset)]) {
-            continue;
-          }
+      u32 f_x = (oam_entry.x + x) % 512;
 
-          background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x).color       = tile_map_texture_buffer_arr[bg.bg_id][(complete_x_offset + complete_y_offset)];
-          background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x).prio        = bg.bg_prio;
-          background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x).bg_id       = bg.bg_id;
-          background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x).transparent = transparency_maps[bg.bg_id][(complete_x_offset + complete_y_offset)];
+      if (f_x >= 240 || palette_index_of_pixel == 0) continue;
 
-        }
+      // OBJ window sprites aren't drawn, they only shape the window
+      if (window_obj) {
+        obj_window[f_x] = 0xFF;
+        continue;
       }
 
-      if (!draw_sprites) {
-        for (size_t x = 0; x < 240; x++) {
-          const auto bg_px = background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x);
-          db.write((LY * SYSTEM_DISPLAY_WIDTH) + x, bg_px.color);
-        }
-        break;
-      }
+      if (layer.opaque[f_x]) continue;
 
-      // process sprites
-      // TODO: can just reinterpret cast the OAM
-      // when it comes to repopulation, it is only necessary when OAM is written to, OR when >=
-      std::memcpy(entries.data(), bus->OAM.data(), 0x400); // TODO: expensive! find another way
-      repopulate_objs();  // TODO: a write to change 1 entry will lead to us re-populating the entire table -- re-populate by index
+      layer.color[f_x]          = get_obj_color_by_index(palette_index_of_pixel, oam_entry.pal_number, oam_entry.color_depth);
+      layer.prio[f_x]           = oam_entry.priority_relative_to_bg;
+      layer.opaque[f_x]         = 0xFF;
+      obj_semi_transparent[f_x] = semi;
+    }
+  }
+}
 
-      for (int entry_idx = 0; entry_idx < 128; entry_idx++) {
-        const OAM_Entry& oam_entry = entries.at(entry_idx);
+// LAYER -> its bit in WININ/WINOUT/BLDCNT. slot 6 stands for a semi-transparent OBJ, 7 for no layer at all
+static constexpr std::array<u8, 8> LAYER_BITS = {1 << 4, 1 << 0, 1 << 1, 1 << 2, 1 << 3, 1 << 5, 1 << 4, 0};
+static constexpr u8 SEMI_TRANSPARENT_OBJ      = 6;
+static constexpr u8 WINDOW_EFFECTS_BIT        = 1 << 5;
 
-        if (oam_entry.obj_disable_double_sz_flag) continue;          // obj is disabled
-        if (oam_entry.obj_mode == OBJ_MODE::PROHIBITED) continue;    // obj has a probihibted mode
-        if (oam_entry.obj_shape == OBJ_SHAPE::PROHIBITED) continue;  // obj is probihibted shape
+// a window covers [start, end), wrapping around when start is past end
+static bool in_window_range(u32 v, u32 start, u32 end) { return start <= end ? (v >= start && v < end) : (v >= start || v < end); }
 
-        u16 y_relative_to_top_of_obj = (((i16)LY - (i16)oam_entry.y) + 256) % 256;
-        if (y_relative_to_top_of_obj >= (get_obj_height(oam_entry) * 8)) continue;
+bool PPU::build_window_mask() {
+  const auto& DISPCNT = display_fields.DISPCNT;
+  const auto& LY      = display_fields.VCOUNT.LY;
 
-        if (((oam_entry.y + (get_obj_height(oam_entry) * 8)) % 256) <= LY) continue;  // we've passed the last scanline
+  if (!DISPCNT.WINDOW_0_DISPLAY_FLAG && !DISPCNT.WINDOW_1_DISPLAY_FLAG && !DISPCNT.OBJ_WINDOW_DISPLAY_FLAG) {
+    window_mask.fill(0x3F);
+    return false;
+  }
 
-        auto obj_width = get_obj_width(oam_entry);
-        // auto obj_height = get_obj_height(oam_entry);
+  window_mask.fill(display_fields.WINOUT.v & 0x3F);
 
-        for (size_t tile_x = 0; tile_x < obj_width; tile_x++) {
-          for (u8 pixel_x = 0; pixel_x < 8; pixel_x++) {
-            const auto& palette_index_of_pixel = objs[entry_idx].data.at(((y_relative_to_top_of_obj) * 64) + (tile_x * 8) + pixel_x);
+  // OBJ window sprites are OBJs too, with OBJs off the window is empty and WINOUT covers the whole line
+  if (DISPCNT.OBJ_WINDOW_DISPLAY_FLAG && DISPCNT.SCREEN_DISPLAY_OBJ) {
+    const u8 inside = (display_fields.WINOUT.v >> 8) & 0x3F;
 
-            auto clr = get_obj_color_by_index(palette_index_of_pixel, oam_entry.pal_number, oam_entry.color_depth);
+    for (u32 x = 0; x < SYSTEM_DISPLAY_WIDTH; x++) window_mask[x] = (obj_window[x] & inside) | (~obj_window[x] & window_mask[x]);
+  }
 
-            u32 line_height = (oam_entry.y + y_relative_to_top_of_obj) % 256;
-            line_height *= 256;
-            u32 f_x = (oam_entry.x + (tile_x * 8) + pixel_x) % 512;
+  // WIN1 goes first so WIN0 wins where the two overlap
+  auto fill_window = [&](bool enabled, const auto& h, const auto& v, u8 bits) {
+    if (!enabled || !in_window_range(LY, v.Y1, v.Y2)) return;
 
-            // if (line_height + f_x >= 65536) continue;
-            if (f_x >= 240) continue;
+    const u32 x1 = std::min<u32>(h.X1, SYSTEM_DISPLAY_WIDTH);
+    const u32 x2 = std::min<u32>(h.X2, SYSTEM_DISPLAY_WIDTH);
 
-            auto& obj_px = sprite_layer.at(line_height + f_x);
+    if (x1 <= x2) {
+      std::fill(window_mask.begin() + x1, window_mask.begin() + x2, bits);
+    } else {
+      std::fill(window_mask.begin(), window_mask.begin() + x2, bits);
+      std::fill(window_mask.begin() + x1, window_mask.end(), bits);
+    }
+  };
 
-            if (obj_px.prio < oam_entry.priority_relative_to_bg) continue;
-            if (obj_px.oam_idx < entry_idx) continue;
+  fill_window(DISPCNT.WINDOW_1_DISPLAY_FLAG, display_fields.WIN1H, display_fields.WIN1V, (display_fields.WININ.v >> 8) & 0x3F);
+  fill_window(DISPCNT.WINDOW_0_DISPLAY_FLAG, display_fields.WIN0H, display_fields.WIN0V, display_fields.WININ.v & 0x3F);
 
-            if (palette_index_of_pixel == 0) continue;
+  return true;
+}
 
-            obj_px.color       = clr;
-            obj_px.prio        = oam_entry.priority_relative_to_bg;
-            obj_px.transparent = palette_index_of_pixel == 0;
-            obj_px.oam_idx     = entry_idx;
+void PPU::blend_scanline() {
+  const auto& BLDCNT = display_fields.BLDCNT;
+  const BlendTables tables{.rgb = BGR555_TO_RGB888_LUT.data(), .brighter = palette_brighter.data(), .darker = palette_darker.data(), .evy = palette_evy};
 
-            // TODO: re-implement writing to obj texture buffer (for obj window screen in debugger)
-            // obj_texture_buffer[line_height + f_x] = clr;
-            // db.write((LY * MAIN_VIEWPORT_PITCH) + f_x, clr);
-          }
-        }
-      }
+  // palette writes only keep the faded entries up to date while something fades
+  const bool fades = BLDCNT.COLOR_SPECIAL_FX == COLOR_FX::BRIGHTNESS_INCREASE || BLDCNT.COLOR_SPECIAL_FX == COLOR_FX::BRIGHTNESS_DECREASE;
 
-      for (size_t x = 0; x < 240; x++) {
-        // BG ID = 0 -- OBJ PRIO = 1 // BG GETS DRAWN OVER OBJ
-        const auto& bg_px  = background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x);
-        const auto& obj_px = sprite_layer.at((LY * 256) + x);
-
-        // lower number wins
-        if (obj_px.prio > bg_px.prio) {  // draw bg
-          db.write((LY * SYSTEM_DISPLAY_WIDTH) + x, bg_px.color);
-          // if (bg_px.transparent && bg_px.prio == 0) db.write((LY * MAIN_VIEWPORT_PITCH) + x, Colors::RED);
-          // if (bg_px.transparent && bg_px.prio == 1) db.write((LY * MAIN_VIEWPORT_PITCH) + x, Colors::GREEN);
-          // if (bg_px.transparent && bg_px.prio == 2) db.write((LY * MAIN_VIEWPORT_PITCH) + x, Colors::BLUE);
-          // if (bg_px.transparent && bg_px.prio == 3) db.write((LY * MAIN_VIEWPORT_PITCH) + x, Colors::BLUE + 0x2000);
-          if (bg_px.transparent) {
-            db.write((LY * SYSTEM_DISPLAY_WIDTH) + x, sprite_layer.at((LY * 256) + x).color);
-          }
+  if (!fades) {
+    palette_fades_stale = true;
+  } else if (palette_fades_stale) {
+    refresh_palette_fades();
+  }
 
-        } else {
-          if (!(sprite_layer.at((LY * 256) + x).transparent)) {
-            // auto s_c = sprite_layer.at((LY * 256) + x).color;
-            db.write((LY * SYSTEM_DISPLAY_WIDTH) + x, sprite_layer.at((LY * 256) + x).color);
-            // if (s_c) db.write((LY * MAIN_VIEWPORT_PITCH) + x, 0x1231231);
-          } else {
-            db.write((LY * SYSTEM_DISPLAY_WIDTH) + x, bg_px.color);
-          }
+  // nothing to blend, the kernel only turns the line into host colours
+  if (BLDCNT.COLOR_SPECIAL_FX == COLOR_FX::NONE && !(display_fields.DISPCNT.SCREEN_DISPLAY_OBJ && line_has_semi_transparent_obj)) {
+    blend_effect.fill(EFFECT_NONE);
+    blend(composite_line, blend_effect.data(), tables, 0, 0, blended_line.data());
+    return;
+  }
+
+  const u8 first     = BLDCNT.v & 0x3F;
+  const u8 second    = (BLDCNT.v >> 8) & 0x3F;
+
+  // the effect of every top/bottom layer pair, so the per pixel part is a lookup
+  std::array<u8, 64> effects = {};
+
+  for (u32 top = 0; top < 8; top++) {
+    for (u32 bottom = 0; bottom < 8; bottom++) {
+      const bool is_first  = first & LAYER_BITS[top];
+      const bool is_second = second & LAYER_BITS[bottom];
+      u8 effect            = EFFECT_NONE;
+
+      if (top == SEMI_TRANSPARENT_OBJ && is_second) {
+        effect = EFFECT_ALPHA;  // whatever BLDCNT says about targets and mode
+      } else if (is_first) {
+        switch (BLDCNT.COLOR_SPECIAL_FX) {
+          case COLOR_FX::ALPHA_BLENDING: effect = is_second ? EFFECT_ALPHA : EFFECT_NONE; break;
+          case COLOR_FX::BRIGHTNESS_INCREASE: effect = EFFECT_BRIGHTEN; break;
+          case COLOR_FX::BRIGHTNESS_DECREASE: effect = EFFECT_DARKEN; break;
+          default: break;
         }
       }
-      break;
+
+      effects[(top << 3) | bottom] = effect;
     }
+  }
 
-    case MODE_1: {
+  for (u32 x = 0; x < SYSTEM_DISPLAY_WIDTH; x++) {
+    u32 top = composite_line.top_layer[x];
+    if (top == LAYER_OBJ && obj_semi_transparent[x]) top = SEMI_TRANSPARENT_OBJ;
+
+    blend_effect[x] = (window_mask[x] & WINDOW_EFFECTS_BIT) ? effects[(top << 3) | composite_line.bottom_layer[x]] : u8{EFFECT_NONE};
+  }
+
+  const u32 eva = std::min<u32>(display_fields.BLDALPHA.EVA_COEFFICIENT_FIRST_TARGET, 16);
+  const u32 evb = std::min<u32>(display_fields.BLDALPHA.EVA_COEFFICIENT_SECOND_TARGET, 16);
+
+  blend(composite_line, blend_effect.data(), tables, eva, evb, blended_line.data());
+}
+
+void PPU::compose_scanline() {
+  // the BGs each mode has, mode 2 has no renderer yet
+  static constexpr std::array<u8, 6> MODE_BGS = {0b1111, 0b0111, 0b1100, 0b0100, 0b0100, 0b0100};
+
+  const auto& LY      = display_fields.VCOUNT.LY;
+  const auto& DISPCNT = display_fields.DISPCNT;
+
+  std::array<u8, LAYER_BACKDROP> ids = {};
+  u32 count                          = 0;
+
+  for (u8 bg = 0; bg < 4; bg++) {
+    if (((MODE_BGS[DISPCNT.BG_MODE] >> bg) & 1) && background_enabled(bg)) ids[count++] = LAYER_BG0 + bg;
+  }
+
+  if (DISPCNT.SCREEN_DISPLAY_OBJ) {
+    render_obj_scanline();
+    ids[count++] = LAYER_OBJ;
+  }
+
+  // windows only ever take layers away, so they're applied to the opaque masks before anything gets resolved
+  if (build_window_mask()) {
+    for (u32 i = 0; i < count; i++) {
+      LayerLine& layer = layer_lines[ids[i]];
+      const u8 bit     = LAYER_BITS[ids[i]];
+
+      for (u32 x = 0; x < SYSTEM_DISPLAY_WIDTH; x++) layer.opaque[x] &= (window_mask[x] & bit) ? u8{0xFF} : u8{0};
+    }
+  }
+
+  composite(layer_lines, ids.data(), count, palette[0], composite_line);
+
+  blend_scanline();
+  db.write_line(LY * SYSTEM_DISPLAY_WIDTH, blended_line.data(), SYSTEM_DISPLAY_WIDTH);
+}
+
+void PPU::render_bitmap_scanline() {
+  const u8 mode  = display_fields.DISPCNT.BG_MODE;
+  const u32 page = display_fields.DISPCNT.DISPLAY_FRAME_SELECT ? BITMAP_MODE_PAGE_OFFSET : 0;
+
+  // mode 5 only covers a 160x128 viewport, everything around it shows whatever is below BG2
+  const i32 width  = mode == MODE_5 ? 160 : 240;
+  const i32 height = mode == MODE_5 ? 128 : 160;
+
+  const i32 pa = static_cast<i16>(display_fields.BG2PA.v);
+  const i32 pc = static_cast<i16>(display_fields.BG2PC.v);
+
+  i32 ref_x = latched_bg2x;
+  i32 ref_y = latched_bg2y;
+
+  LayerLine& layer = layer_lines[LAYER_BG2];
+  layer.opaque.fill(0);
+  layer.prio.fill(get_bg_prio(2));
+
+  for (size_t x = 0; x < 240; x++, ref_x += pa, ref_y += pc) {
+    i32 tex_x = ref_x >> 8;
+    i32 tex_y = ref_y >> 8;
+
+    if (tex_x < 0 || tex_x >= width || tex_y < 0 || tex_y >= height) continue;  // bitmaps don't wrap
+
+    u32 pixel = static_cast<u32>((tex_y * width) + tex_x);
+    u32 color;
+
+    if (mode == MODE_4) {
+      u8 palette_index = VRAM[page + pixel];
+      if (palette_index == 0) continue;
+
+      color = get_color_by_index(palette_index, 0, COLOR_DEPTH::BPP8);
+    } else {
+      u32 addr = (mode == MODE_5 ? page : 0) + (pixel * 2);
+      color    = DIRECT_COLOR | (*(u16*)(&VRAM[addr]) & 0x7FFF);
+    }
+
+    layer.color[x]  = color;
+    layer.opaque[x] = 0xFF;
+  }
+}
+
+void PPU::reload_affine_reference() {
+  latched_bg2x = sign_extend_reference(display_fields.BG2X.v);
+  latched_bg2y = sign_extend_reference(display_fields.BG2Y.v);
+  latched_bg3x = sign_extend_reference(display_fields.BG3X.v);
+  latched_bg3y = sign_extend_reference(display_fields.BG3Y.v);
+}
+
+void PPU::advance_affine_reference() {
+  latched_bg2x += static_cast<i16>(display_fields.BG2PB.v);
+  latched_bg2y += static_cast<i16>(display_fields.BG2PD.v);
+  latched_bg3x += static_cast<i16>(display_fields.BG3PB.v);
+  latched_bg3y += static_cast<i16>(display_fields.BG3PD.v);
+}
+
+void PPU::step() {
+  if (display_fields.VCOUNT.LY == 0) mosaic_source_line.fill(NO_MOSAIC_LINE);
+
+  switch (display_fields.DISPCNT.BG_MODE) {
+    case MODE_0: {
       const auto& LY = display_fields.VCOUNT.LY;
 
       // TODO: do we really need this on the stack each single time?
-      std::array screen_sizes = {
+      std::array<u8, 4> screen_sizes = {
           display_fields.BG0CNT.SCREEN_SIZE,
           display_fields.BG1CNT.SCREEN_SIZE,
           display_fields.BG2CNT.SCREEN_SIZE,
           display_fields.BG3CNT.SCREEN_SIZE,
       };
-      std::array bg_bpp = {
+      std::array<COLOR_DEPTH, 4> bg_bpp = {
           display_fields.BG0CNT.color_depth,
           display_fields.BG1CNT.color_depth,
           display_fields.BG2CNT.color_depth,
           display_fields.BG3CNT.color_depth,
       };
 
+      if (LY > 159) break;
 
-      // process non affine bgs
-      for (u8 bg = 0; bg < 2; bg++) {
-        // fmt::println("BG: {}", bg);
-        if (!background_enabled(bg)) continue;
-
-        auto [x_offset, y_offset] = get_text_bg_offset(bg);
-
-        // load tiles into tilesets from charblocks
-        load_tiles(bg, bg_bpp[bg]);  // only gets called when dispstat corresponding to bg changes
-       
-        // Load screenblocks to our background tile map
-        switch (screen_sizes[bg]) {
-          case 0: {
-            // [0]
-            u8 map_x = 0;
-            // let's calculate tile y beforehand...
-            u8 tile_y = ((LY + y_offset) % 256) / 8;
-
-            // TODO: probably shouldn't re-populate screenblock entry map every single scanline -- expensive
-            // for (size_t tile_y = 0; tile_y < 32; tile_y++) {
-            for (u32 tile_x = 0; tile_x < 32; tile_x++) {
-              u32 dest = (tile_y * 64) + tile_x;
-
-              tile_maps[bg][dest] = ScreenBlockEntryMode0{
-                  .v = bus->read16(absolute_sbb(bg, map_x) + ((tile_x + (tile_y * 32)) * 2)),  // should be able to directly access vram, bus adds alot of overhead
-
-              };
-            }
-            break;
-          }
-          case 1: {
-            // [0][1]
-
-            for (u32 map_x = 0; map_x < 2; map_x++) {
-              for (u32 tile_y = 0; tile_y < 32; tile_y++) {
-                for (u32 tile_x = 0; tile_x < 32; tile_x++) {
-                  u32 dest = (tile_y * 64) + tile_x + (map_x * 32);
-
-                  tile_maps[bg][dest] = ScreenBlockEntryMode0{
-                      .v = bus->read16(absolute_sbb(bg, map_x) + ((tile_x + (tile_y * 32)) * 2)),
-                  };
-                }
-              }
-            };
-            break;
-          }
-          case 2: {
-            // [0]
-            // [1]
-            for (u32 map_x = 0; map_x < 2; map_x++) {
-              for (u32 tile_y = 0; tile_y < 32; tile_y++) {
-                for (u32 tile_x = 0; tile_x < 32; tile_x++) {
-                  u32 dest = (tile_y * 64) + tile_x + (map_x * (32 * 64));
-
-                  tile_maps[bg][dest] = ScreenBlockEntryMode0{
-                      .v = bus->read16(absolute_sbb(bg, map_x) + ((tile_x + (tile_y * 32)) * 2)),
-                  };
-                }
-              }
-            };
-            break;
-          }
-          case 3: {
-            // [0][1]
-            // [2][3]
-            for (u32 map_x = 0; map_x < 4; map_x++) {
-              for (u32 tile_y = 0; tile_y < 32; tile_y++) {
-                for (u32 tile_x = 0; tile_x < 32; tile_x++) {
-                  u32 dest = (tile_y * 64) + tile_x + (map_x * 32);
-
-                  if (map_x == 2) {
-                    dest = (tile_y * 64) + tile_x + (64 * 32);
-                  }
-                  if (map_x == 3) {
-                    dest = (tile_y * 64) + tile_x + (64 * 32) + (32);
-                  }
-
-                  tile_maps[bg][dest] = ScreenBlockEntryMode0{
-                      .v = bus->read16(absolute_sbb(bg, map_x) + ((tile_x + (tile_y * 32)) * 2)),
-                  };
-                }
-              }
-            };
-            // assert(0);
-            break;
-          }
-        }
-
-        auto [x_render_offset, y_render_offset] = get_render_offset(screen_sizes[bg]);
+      // process bgs
+      for (u8 bg = 0; bg < 4; bg++) {
+        if (!background_enabled(bg) || bg_mosaic_hold(bg)) continue;
 
-        // write scanlines to the buffers
-        u8 tile_y = ((LY + y_offset) % y_render_offset) / 8;
-        u8 y      = ((LY + y_offset) % y_render_offset) % 8;
+        render_text_bg_scanline(bg, screen_sizes[bg], bg_bpp[bg]);
+        bg_mosaic_finish(bg);
 
-        for (size_t tile_x = 0; tile_x < 64; tile_x++) {
-          const ScreenBlockEntryMode0& entry = tile_maps[bg][(tile_y * 64) + tile_x];
-          Tile tile                          = tile_sets[bg][entry.tile_index];
+        //  In case that some or all BGs are set to same priority then BG0 is having the highest, and BG3 the lowest priority.
+      }
 
-          // OBJ are now flipped on a individual level, but the order of OBJ is what needs to be flipped, (including the OBJ being flipped)
-          if (entry.VERTICAL_FLIP) {
-            Tile tb;
+      draw_backdrop_scanline();
 
-            for (size_t row = 0; row < 8; row++) {  // TODO: move into func
-              for (size_t pix_n = 0; pix_n < 8; pix_n++) {
-                tb[(row * 8) + pix_n] = tile[((7 - row) * 8) + pix_n];
-              }
-            }
+      compose_scanline();
+      break;
+    }
 
-            tile = tb;
-          }
-          if (entry.HORIZONTAL_FLIP) {
-            for (size_t row = 0; row < 8; row++) {  // TODO: move into func
-              std::reverse(tile.begin() + (row * 8), (tile.begin() + 8 + (row * 8)));
-            }
-          }
+    case MODE_1: {
+      const auto& LY = display_fields.VCOUNT.LY;
 
-          for (size_t x = 0; x < 8; x++) {
-            auto clr = get_color_by_index(tile[(y * 8) + x], entry.PAL_BANK, bg_bpp[bg]);
+      // TODO: do we really need this on the stack each single time?
+      std::array screen_sizes = {
+          display_fields.BG0CNT.SCREEN_SIZE,
+          display_fields.BG1CNT.SCREEN_SIZE,
+          display_fields.BG2CNT.SCREEN_SIZE,
+          display_fields.BG3CNT.SCREEN_SIZE,
+      };
+      std::array bg_bpp = {
+          display_fields.BG0CNT.color_depth,
+          display_fields.BG1CNT.color_depth,
+          display_fields.BG2CNT.color_depth,
+          display_fields.BG3CNT.color_depth,
+      };
 
-            // Palette Index = 0 -- if so save entry in the transparency map. Used during composition
-            transparency_maps[bg][((tile_y * (SCREEN_WIDTH * 8)) + (y * SCREEN_WIDTH) + ((tile_x * 8) + x))] = ((tile[(y * 8) + x] == 0));
 
-            tile_map_texture_buffer_arr[bg][((tile_y * (SCREEN_WIDTH * 8)) + (y * SCREEN_WIDTH) + ((tile_x * 8) + x))] = clr;
-          }
-        }
+      // process non affine bgs
+      for (u8 bg = 0; bg < 2; bg++) {
+        // fmt::println("BG: {}", bg);
+        if (LY > 159 || !background_enabled(bg) || bg_mosaic_hold(bg)) continue;
 
-        // if (LY > 159) continue;
+        render_text_bg_scanline(bg, screen_sizes[bg], bg_bpp[bg]);
+        bg_mosaic_finish(bg);
       }
 
       // process affine bg
       if (background_enabled(2)) {
         u8 tile_y = (LY) % 256 / 8;
         // fmt::println("HI");
-        load_tiles(2, COLOR_DEPTH::BPP8);  // only gets called when dispstat corresponding to bg changes
 
         // TODO: probably shouldn't re-populate screenblock entry map every single scanline -- expensive
         // for (size_t tile_y = 0; tile_y < 32; tile_y++) {
@@ -771,7 +876,7 @@ void PPU::step() {
           u32 dest = (tile_y * 64) + tile_x;
 
           affine_tile_maps[2][dest] = ScreenBlockEntryMode1{
-              .tile_index = bus->read8(absolute_sbb(2, 0) + (tile_x + tile_y * 32)),  // should be able to directly access vram, bus adds alot of overhead
+              .tile_index = VRAM[relative_sbb(2) + (tile_x + tile_y * 32)],
           };
         }
 
@@ -781,14 +886,14 @@ void PPU::step() {
 
         for (size_t tile_x = 0; tile_x < affine_map_width; tile_x++) {
           const ScreenBlockEntryMode1& entry = affine_tile_maps[2][(tile_y * affine_map_width) + tile_x];
-          Tile tile                          = tile_sets[2][entry.tile_index];
+          const Tile& tile                   = get_bg_tile(2, entry.tile_index, COLOR_DEPTH::BPP8);
 
           for (size_t x = 0; x < 8; x++) {
-            auto clr = get_color_by_index(tile[(y * 8) + x], 0, COLOR_DEPTH::BPP8);
+            auto clr = host_color(get_color_by_index(tile[(y * 8) + x], 0, COLOR_DEPTH::BPP8));
 
-            // Palette Index = 0 -- if so save entry in the transparency map. Used during composition
+            // the index is what the layer gets, 0 is transparent
 
-            transparency_maps[2][((tile_y * (SCREEN_WIDTH * 8)) + (y * SCREEN_WIDTH) + ((tile_x * 8) + x))] = ((tile[(y * 8) + x] == 0));
+            affine_index_maps[2][((tile_y * (SCREEN_WIDTH * 8)) + (y * SCREEN_WIDTH) + ((tile_x * 8) + x))] = tile[(y * 8) + x];
             // rot_scal_bg2_buf[((tile_y * (SCREEN_WIDTH * 8)) + (y * SCREEN_WIDTH) + ((tile_x * 8) + x))] = ((tile[(y * 8) + x] == 0));
 
             tile_map_affine_texture_buffer_arr[2][((tile_y * (SCREEN_WIDTH * 8)) + (y * SCREEN_WIDTH) + ((tile_x * 8) + x))] = clr;
@@ -796,191 +901,42 @@ void PPU::step() {
         }
       }
 
-      if (LY > 159) return;
-
-      const bool draw_sprites = display_fields.DISPCNT.SCREEN_DISPLAY_OBJ;
-
-      // ====================================  composition ====================================
-      std::vector<Item> active_bgs = {};
-
-      // determine priority
-      for (int bg = 2; bg >= 0; bg--) {
-        if (!background_enabled(bg)) {
-          continue;
-        }
-        active_bgs.emplace_back(static_cast<u8>(bg), get_bg_prio(bg));
-      }
-
-      std::ranges::stable_sort(active_bgs, [](const Item& a, const Item& b) {
-        if (a.bg_prio != b.bg_prio) return a.bg_prio > b.bg_prio;  // primary
-        return a.bg_id > b.bg_id;                                  // tiebreaker
-      });
+      if (LY > 159) break;
 
-      // draw backdrop
-      for (size_t x = 0; x < 240; x++) {
-        backdrop[(LY * SYSTEM_DISPLAY_WIDTH) + x] = get_color_by_index(0, 0, COLOR_DEPTH::BPP4);
-        auto& bg_pixel                            = background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x);
-
-        bg_pixel.prio  = 5;
-        bg_pixel.color = get_color_by_index(0, 0, COLOR_DEPTH::BPP4);
-      }
-
-      for (const auto& bg : active_bgs) {
-        auto [x_offset, y_offset]               = get_text_bg_offset(bg.bg_id);
-        auto [x_render_offset, y_render_offset] = get_render_offset(screen_sizes[bg.bg_id]);
-
-        if (bg.bg_id == 2) {
-          x_offset        = 0;
-          y_offset        = 0;
-          x_render_offset = 0;
-          y_render_offset = 0;
-        }
+      if (background_enabled(2) && !bg_mosaic_hold(2)) {
+        LayerLine& layer = layer_lines[LAYER_BG2];
+        const u8 prio    = get_bg_prio(2);
 
         for (size_t x = 0; x < 240; x++) {
-          auto& bg_px = background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x);
-          u32 complete_x_offset;
-          u32 complete_y_offset;
-
-          if (bg.bg_id == 2) {
-            complete_x_offset = (x + latched_bg2x) % 1024;
-            complete_y_offset = ((LY + y_offset)) * 512;
-
-            // complete_x_offset = (x) % 1024;
-            // complete_y_offset = ((LY + y_offset)) * 512;
-
-          } else {
-            complete_x_offset = (x + x_offset) % x_render_offset;
-            complete_y_offset = ((LY + y_offset) % y_render_offset) * 512;
-          }
-
-          if (transparency_maps[bg.bg_id][(complete_x_offset + complete_y_offset)]) {
-            continue;
-          }
+          u32 complete_x_offset = (x + static_cast<u32>(latched_bg2x >> 8)) % 1024;
+          u32 complete_y_offset = LY * 512;
 
-          if (bg.bg_id == 2) {
-            bg_px.color = tile_map_affine_texture_buffer_arr[2][(complete_x_offset + complete_y_offset)];
-            // fmt::println("{}", bg_px.color);
-          } else {
-            bg_px.color = tile_map_texture_buffer_arr[bg.bg_id][(complete_x_offset + complete_y_offset)];
-          }
-          bg_px.prio = bg.bg_prio;
+          const u8 index = affine_index_maps[2][(complete_x_offset + complete_y_offset)];
 
-          // if (!draw_sprites) {
-          //   // fmt::println("BG{} -> {}", bg.bg_id,tile_map_texture_buffer_arr[bg.bg_id][(complete_x_offset + complete_y_offset)]);
-          // }
+          layer.color[x]  = palette[index];
+          layer.prio[x]   = prio;
+          layer.opaque[x] = index ? 0xFF : 0;
         }
-      }
 
-      if (!draw_sprites) {
-        for (size_t x = 0; x < 240; x++) {
-          const auto bg_px = background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x);
-          db.write((LY * SYSTEM_DISPLAY_WIDTH) + x, bg_px.color);
-        }
-        break;
+        bg_mosaic_finish(2);
       }
 
-      // process sprites
-      // TODO: can just reinterpret cast the OAM
-      // when it comes to repopulation, it is only necessary when OAM is written to, OR when >=
-      std::memcpy(entries.data(), bus->OAM.data(), 0x400);
-      // state.oam_changed = false;
-      repopulate_objs();  // TODO: a write to change 1 entry will lead to us re-populating the entire table -- re-populate by index
-
-      for (int entry_idx = 0; entry_idx < 128; entry_idx++) {
-        const OAM_Entry& oam_entry = entries.at(entry_idx);
-
-        if (oam_entry.obj_disable_double_sz_flag) continue;          // obj is disabled
-        if (oam_entry.obj_mode == OBJ_MODE::PROHIBITED) continue;    // obj has a probihibted mode
-        if (oam_entry.obj_shape == OBJ_SHAPE::PROHIBITED) continue;  // obj is probihibted shape
-
-        u16 y_relative_to_top_of_obj = (((i16)LY - (i16)oam_entry.y) + 256) % 256;
-        if (y_relative_to_top_of_obj >= (get_obj_height(oam_entry) * 8)) continue;
-
-        if (((oam_entry.y + (get_obj_height(oam_entry) * 8)) % 256) <= LY) continue;  // we've passed the last scanline
-
-        auto obj_width = get_obj_width(oam_entry);
-
-        for (size_t tile_x = 0; tile_x < obj_width; tile_x++) {
-          for (u8 pixel_x = 0; pixel_x < 8; pixel_x++) {
-            const auto& palette_index_of_pixel = objs[entry_idx].data.at(((y_relative_to_top_of_obj) * 64) + (tile_x * 8) + pixel_x);
+      draw_backdrop_scanline();
 
-            auto clr = get_obj_color_by_index(palette_index_of_pixel, oam_entry.pal_number, oam_entry.color_depth);
-
-            u32 line_height = (oam_entry.y + y_relative_to_top_of_obj) % 256;
-            line_height *= 256;
-            u32 f_x = (oam_entry.x + (tile_x * 8) + pixel_x) % 512;
-
-            if (f_x >= 240) continue;
-
-            auto& obj_px = sprite_layer.at(line_height + f_x);
-
-            if (obj_px.prio < oam_entry.priority_relative_to_bg) continue;
-            if (obj_px.oam_idx < entry_idx) continue;
-
-            if (palette_index_of_pixel == 0) continue;
-
-            obj_px.color       = clr;
-            obj_px.prio        = oam_entry.priority_relative_to_bg;
-            obj_px.transparent = palette_index_of_pixel == 0;
-            obj_px.oam_idx     = entry_idx;
-
-            // obj_texture_buffer[line_height + f_x] = clr;
-            // db.write((LY * MAIN_VIEWPORT_PITCH) + f_x, clr);
-          }
-        }
-        // fmt::print("\n");
-      }
-
-      for (size_t x = 0; x < 240; x++) {
-        // BG ID = 0 -- OBJ PRIO = 1 // BG GETS DRAWN OVER OBJ
-        const auto& bg_px  = background_layer.at((LY * SYSTEM_DISPLAY_WIDTH) + x);
-        const auto& obj_px = sprite_layer.at((LY * 256) + x);
-
-        // lower number wins
-        if (obj_px.prio > bg_px.prio) {  // draw bg
-          db.write((LY * SYSTEM_DISPLAY_WIDTH) + x, bg_px.color);
-          // if (bg_px.transparent && bg_px.prio == 0) db.write((LY * MAIN_VIEWPORT_PITCH) + x, Colors::RED);
-          // if (bg_px.transparent && bg_px.prio == 1) db.write((LY * MAIN_VIEWPORT_PITCH) + x, Colors::GREEN);
-          // if (bg_px.transparent && bg_px.prio == 2) db.write((LY * MAIN_VIEWPORT_PITCH) + x, Colors::BLUE);
-          // if (bg_px.transparent && bg_px.prio == 3) db.write((LY * MAIN_VIEWPORT_PITCH) + x, Colors::BLUE + 0x2000);
-          if (bg_px.transparent) {
-            db.write((LY * SYSTEM_DISPLAY_WIDTH) + x, sprite_layer.at((LY * 256) + x).color);
-          }
-
-        } else {
-          if (!(sprite_layer.at((LY * 256) + x).transparent)) {
-            // auto s_c = sprite_layer.at((LY * 256) + x).color;
-            db.write((LY * SYSTEM_DISPLAY_WIDTH) + x, sprite_layer.at((LY * 256) + x).color);
-            // if (s_c) db.write((LY * MAIN_VIEWPORT_PITCH) + x, 0x1231231);
-          } else {
-            db.write((LY * SYSTEM_DISPLAY_WIDTH) + x, bg_px.color);
-          }
-        }
-      }
+      compose_scanline();
       break;
     }
-    case MODE_3: {
-      // fmt::println("MODE_3");
-      for (size_t i = 0, j = 0; i < (240 * 160); i++, j += 2) {
-        db.write(i, BGR555_TO_RGB888_LUT[(VRAM.at(j)) | (VRAM.at(j + 1) << 8)]);
+    case MODE_3:
+    case MODE_4:
+    case MODE_5: {
+      if (display_fields.VCOUNT.LY > 159) break;
+
+      draw_backdrop_scanline();
+      if (background_enabled(2) && !bg_mosaic_hold(2)) {
+        render_bitmap_scanline();
+        bg_mosaic_finish(2);
       }
-
-      // db.swap_buffers();
-      break;
-    };
-    case MODE_4: {
-      // fmt::println("MODE_4 - LY: {}", display_fields.VCOUNT.LY);
-      const auto& LY   = display_fields.VCOUNT.LY;
-      const auto& page = display_fields.DISPCNT.DISPLAY_FRAME_SELECT;
-
-      if (LY > 159) return;
-
-      for (size_t i = 0; i < 240; i++) {
-        db.write(((LY * 240) + i), get_color_by_index(VRAM.at(((LY * 240) + i) + (BITMAP_MODE_PAGE_OFFSET * page)), 0, COLOR_DEPTH::BPP8));
-      }
-
-      // if(LY == 159) db.swap_buffers();
-
+      compose_scanline();
       break;
     }
 
@@ -990,6 +946,13 @@ void PPU::step() {
       break;
     }
   }
+
+  // internal reference points move by dmx/dmy after each visible line and are reloaded once VBLANK starts
+  if (display_fields.VCOUNT.LY < 160) {
+    advance_affine_reference();
+  } else if (display_fields.VCOUNT.LY == 160) {
+    reload_affine_reference();
+  }
 }
 
 u8 PPU::get_bg_prio(u8 bg) const {
@@ -1001,14 +964,4 @@ u8 PPU::get_bg_prio(u8 bg) const {
   }
   assert(0);
   return -1;
-}
-
-void PPU::reset_sprite_layer() {
-  for (auto& r : sprite_layer) {
-    r.prio     = 10;
-    r.active   = false;
-    r.oam_idx  = 128;
-    r.color    = 0;
-    r.color_id = 0;
-  }
 }
\ No newline at end of file
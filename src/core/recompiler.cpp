@@ -0,0 +1,426 @@
+#include <algorithm>
+#include <bit>
+#include <vector>
+
+#include "bus.hpp"
+#include "core/cpu.hpp"
+#include "instructions/arm.hpp"
+#include "sched/sched.hpp"
+
+// Host registers inside a translated block:
+//   rbx  cpu
+//   r12  target cycle
+//   r13  &cycles_elapsed
+//   r14  access_cycles entry of the block's opcode fetches
+// Guest registers and CPSR stay in `regs` the whole time, nothing is kept in host registers between instructions.
+// Translated code reads and writes NZCV in CPSR directly, so no lazy flags may be pending while it runs.
+
+static constexpr u32 FLAG_N = 1U << 31;
+static constexpr u32 FLAG_Z = 1U << 30;
+static constexpr u32 FLAG_C = 1U << 29;
+static constexpr u32 FLAG_V = 1U << 28;
+
+enum CarryOut : u8 { CARRY_KEEP, CARRY_ADD, CARRY_SUB, CARRY_SET, CARRY_CLEAR };
+
+static i32 field(const ARM7TDMI* cpu, const void* p) { return static_cast<i32>(static_cast<const u8*>(p) - reinterpret_cast<const u8*>(cpu)); }
+
+// Called after every handler a block falls back to, does what run_block() does between two instructions.
+// Returns 1 if the block has to be left.
+static u32 leave_after_handler(ARM7TDMI* cpu, const ARM7TDMI::Block* block) {
+  cpu->regs.sync_flags();
+  cpu->regs.r[15] += cpu->regs.CPSR.STATE_BIT == THUMB_MODE ? 2 : 4;
+
+  if (cpu->flushed_pipeline || cpu->regs.CPSR.STATE_BIT != block->state) return 1;
+  if (cpu->halted || cpu->bus->dma_requested || cpu->bus->scheduler->preempted) return 1;
+  if (block->code_page != Bus::NO_CODE_PAGE && cpu->bus->code_page_generation[block->code_page] != block->generation) return 1;
+
+  return cpu->irq_ready();
+}
+
+// x86 flags of the last ALU op -> NZCV, only the flags in mask (and C unless kept) change.
+// Clobbers rax, rcx, rdx, r8, r9.
+static void emit_flags(JIT& jit, i32 cpsr, u32 mask, CarryOut carry) {
+  if (mask & FLAG_N) jit.setcc(JIT::S, JIT::RCX);
+  if (mask & FLAG_Z) jit.setcc(JIT::E, JIT::RDX);
+  if (carry == CARRY_ADD) jit.setcc(JIT::B, JIT::R8);
+  if (carry == CARRY_SUB) jit.setcc(JIT::AE, JIT::R8);  // x86 sets CF on borrow, ARM on no borrow
+  if (mask & FLAG_V) jit.setcc(JIT::O, JIT::R9);
+
+  if (carry != CARRY_KEEP) mask |= FLAG_C;
+
+  jit.load32(JIT::RAX, JIT::RBX, cpsr);
+  jit.alu32_imm(JIT::AND, JIT::RAX, ~mask);
+  if (carry == CARRY_SET) jit.alu32_imm(JIT::OR, JIT::RAX, FLAG_C);
+
+  auto merge = [&](JIT::Reg r, u8 bit) {
+    jit.movzx8(r, r);
+    jit.shl32(r, bit);
+    jit.alu32(JIT::OR, JIT::RAX, r);
+  };
+
+  if (mask & FLAG_N) merge(JIT::RCX, 31);
+  if (mask & FLAG_Z) merge(JIT::RDX, 30);
+  if (carry == CARRY_ADD || carry == CARRY_SUB) merge(JIT::R8, 29);
+  if (mask & FLAG_V) merge(JIT::R9, 28);
+
+  jit.store32(JIT::RBX, cpsr, JIT::RAX);
+}
+
+// flags known at translation time (MOVS/MVNS with an immediate)
+static void emit_const_flags(JIT& jit, i32 cpsr, u32 mask, u32 value) {
+  jit.alu32_mem_imm(JIT::AND, JIT::RBX, cpsr, ~mask);
+  if (value & mask) jit.alu32_mem_imm(JIT::OR, JIT::RBX, cpsr, value & mask);
+}
+
+// jumps if the condition fails, returns the displacement to patch
+static u8* emit_condition_check(JIT& jit, i32 cpsr, u16 condition_mask) {
+  jit.load32(JIT::RAX, JIT::RBX, cpsr);
+  jit.shr32(JIT::RAX, 28);
+  jit.mov32_imm(JIT::RCX, condition_mask);
+  jit.bt32(JIT::RCX, JIT::RAX);
+  return jit.jcc(JIT::AE);
+}
+
+// Inline translation of the instruction's effect on registers and flags. Anything that touches memory, r15,
+// the shifter or the banks is left to the handler. Returns false without emitting anything if it can't be done.
+bool ARM7TDMI::jit_emit_instr(const CachedInstr& instr, CPU_MODE state) {
+  const i32 cpsr = field(this, &regs.CPSR);
+  const u32 op   = instr.opcode;
+
+  auto reg = [&](u8 r) { return field(this, &regs.get_reg(r)); };
+
+  // the tables hold per-operation copies, the format comes from decode
+  const FuncPtr format = state == THUMB_MODE ? thumb_decode(static_cast<u16>((op >> 6) & 0x3FF)) : arm_decode(((op & 0xff00000) >> 16) | ((op & 0xF0) >> 4));
+
+  if (state == THUMB_MODE) {
+    if (format == THUMB_MOV_CMP_ADD_SUB) {
+      const u8 Rd = (op >> 8) & 0b111;
+      const u8 nn = op & 0xFF;
+
+      switch ((op >> 11) & 0b11) {
+        case 0: {  // MOV
+          jit.store32_imm(JIT::RBX, reg(Rd), nn);
+          emit_const_flags(jit, cpsr, FLAG_N | FLAG_Z, nn == 0 ? FLAG_Z : 0);
+          break;
+        }
+        case 1: {  // CMP
+          jit.load32(JIT::RAX, JIT::RBX, reg(Rd));
+          jit.alu32_imm(JIT::CMP, JIT::RAX, nn);
+          emit_flags(jit, cpsr, FLAG_N | FLAG_Z | FLAG_V, CARRY_SUB);
+          break;
+        }
+        case 2:    // ADD
+        case 3: {  // SUB
+          const bool add = ((op >> 11) & 0b11) == 2;
+
+          jit.load32(JIT::RAX, JIT::RBX, reg(Rd));
+          jit.alu32_imm(add ? JIT::ADD : JIT::SUB, JIT::RAX, nn);
+          jit.store32(JIT::RBX, reg(Rd), JIT::RAX);
+          emit_flags(jit, cpsr, FLAG_N | FLAG_Z | FLAG_V, add ? CARRY_ADD : CARRY_SUB);
+          break;
+        }
+      }
+
+      return true;
+    }
+
+    if (format == THUMB_ADD_SUB) {
+      const u8 op_type = (op >> 9) & 0b11;
+      const u8 Rs      = (op >> 3) & 0b111;
+      const u8 Rn_imm  = (op >> 6) & 0b111;
+      const u8 Rd      = op & 0b111;
+      const bool add   = op_type == 0 || op_type == 2;
+
+      jit.load32(JIT::RAX, JIT::RBX, reg(Rs));
+      if (op_type < 2) {
+        jit.alu32_mem(add ? JIT::ADD : JIT::SUB, JIT::RAX, JIT::RBX, reg(Rn_imm));
+      } else {
+        jit.alu32_imm(add ? JIT::ADD : JIT::SUB, JIT::RAX, Rn_imm);
+      }
+      jit.store32(JIT::RBX, reg(Rd), JIT::RAX);
+      emit_flags(jit, cpsr, FLAG_N | FLAG_Z | FLAG_V, add ? CARRY_ADD : CARRY_SUB);
+
+      return true;
+    }
+
+    if (format == THUMB_DATA_PROC) {
+      const THUMB_ALU_OP alu = static_cast<THUMB_ALU_OP>((op >> 6) & 0xF);
+      const u8 Rd            = op & 0b111;
+      const u8 Rs            = (op >> 3) & 0b111;
+
+      switch (alu) {
+        case THUMB_ALU_OP::AND:
+        case THUMB_ALU_OP::EOR:
+        case THUMB_ALU_OP::ORR:
+        case THUMB_ALU_OP::TST: {
+          const JIT::AluOp x = alu == THUMB_ALU_OP::EOR ? JIT::XOR : alu == THUMB_ALU_OP::ORR ? JIT::OR : JIT::AND;
+
+          jit.load32(JIT::RAX, JIT::RBX, reg(Rd));
+          jit.alu32_mem(x, JIT::RAX, JIT::RBX, reg(Rs));
+          if (alu != THUMB_ALU_OP::TST) jit.store32(JIT::RBX, reg(Rd), JIT::RAX);
+          emit_flags(jit, cpsr, FLAG_N | FLAG_Z, CARRY_KEEP);
+          return true;
+        }
+        case THUMB_ALU_OP::BIC: {
+          jit.load32(JIT::RCX, JIT::RBX, reg(Rs));
+          jit.not32(JIT::RCX);
+          jit.load32(JIT::RAX, JIT::RBX, reg(Rd));
+          jit.alu32(JIT::AND, JIT::RAX, JIT::RCX);
+          jit.store32(JIT::RBX, reg(Rd), JIT::RAX);
+          emit_flags(jit, cpsr, FLAG_N | FLAG_Z, CARRY_KEEP);
+          return true;
+        }
+        case THUMB_ALU_OP::MVN: {
+          jit.load32(JIT::RAX, JIT::RBX, reg(Rs));
+          jit.not32(JIT::RAX);
+          jit.test32(JIT::RAX, JIT::RAX);  // not doesn't touch the flags
+          jit.store32(JIT::RBX, reg(Rd), JIT::RAX);
+          emit_flags(jit, cpsr, FLAG_N | FLAG_Z, CARRY_KEEP);
+          return true;
+        }
+        case THUMB_ALU_OP::CMP:
+        case THUMB_ALU_OP::CMN: {
+          jit.load32(JIT::RAX, JIT::RBX, reg(Rd));
+          jit.alu32_mem(alu == THUMB_ALU_OP::CMP ? JIT::CMP : JIT::ADD, JIT::RAX, JIT::RBX, reg(Rs));
+          emit_flags(jit, cpsr, FLAG_N | FLAG_Z | FLAG_V, alu == THUMB_ALU_OP::CMP ? CARRY_SUB : CARRY_ADD);
+          return true;
+        }
+        default: return false;
+      }
+    }
+
+    return false;
+  }
+
+  // ARM, data processing with an immediate operand
+  if (format != ARM_DATA_PROCESSING || !(op & (1 << 25))) return false;
+
+  const ALU_OP alu = static_cast<ALU_OP>((op >> 21) & 0xF);
+  const bool S     = op & (1 << 20);
+  const u8 Rn      = (op >> 16) & 0xF;
+  const u8 Rd      = (op >> 12) & 0xF;
+  const u8 rotate  = (op >> 8) & 0xF;
+  const u32 imm    = std::rotr(op & 0xFF, rotate * 2);
+
+  // logical ops take C from the rotate, unless there is none
+  const CarryOut shifter_carry = (!S || rotate == 0) ? CARRY_KEEP : (imm >> 31) ? CARRY_SET : CARRY_CLEAR;
+
+  if (Rd == 15) return false;
+  if (alu != ALU_OP::MOV && alu != ALU_OP::MVN && Rn == 15) return false;
+
+  switch (alu) {
+    case ALU_OP::MOV:
+    case ALU_OP::MVN: {
+      const u32 value = alu == ALU_OP::MOV ? imm : ~imm;
+
+      jit.store32_imm(JIT::RBX, reg(Rd), value);
+
+      if (S) {
+        u32 mask  = FLAG_N | FLAG_Z;
+        u32 flags = (value & FLAG_N) | (value == 0 ? FLAG_Z : 0);
+
+        if (shifter_carry != CARRY_KEEP) mask |= FLAG_C;
+        if (shifter_carry == CARRY_SET) flags |= FLAG_C;
+
+        emit_const_flags(jit, cpsr, mask, flags);
+      }
+      return true;
+    }
+    case ALU_OP::AND:
+    case ALU_OP::EOR:
+    case ALU_OP::ORR:
+    case ALU_OP::BIC:
+    case ALU_OP::TST:
+    case ALU_OP::TEQ: {
+      const bool test = alu == ALU_OP::TST || alu == ALU_OP::TEQ;
+      if (test && !S) return false;
+
+      const JIT::AluOp x = (alu == ALU_OP::EOR || alu == ALU_OP::TEQ) ? JIT::XOR : alu == ALU_OP::ORR ? JIT::OR : JIT::AND;
+
+      jit.load32(JIT::RAX, JIT::RBX, reg(Rn));
+      jit.alu32_imm(x, JIT::RAX, alu == ALU_OP::BIC ? ~imm : imm);
+      if (!test) jit.store32(JIT::RBX, reg(Rd), JIT::RAX);
+      if (S) emit_flags(jit, cpsr, FLAG_N | FLAG_Z, shifter_carry);
+      return true;
+    }
+    case ALU_OP::ADD:
+    case ALU_OP::SUB:
+    case ALU_OP::CMP:
+    case ALU_OP::CMN: {
+      const bool test = alu == ALU_OP::CMP || alu == ALU_OP::CMN;
+      const bool add  = alu == ALU_OP::ADD || alu == ALU_OP::CMN;
+      if (test && !S) return false;
+
+      jit.load32(JIT::RAX, JIT::RBX, reg(Rn));
+      jit.alu32_imm(add ? JIT::ADD : JIT::SUB, JIT::RAX, imm);
+      if (!test) jit.store32(JIT::RBX, reg(Rd), JIT::RAX);
+      if (S) emit_flags(jit, cpsr, FLAG_N | FLAG_Z | FLAG_V, add ? CARRY_ADD : CARRY_SUB);
+      return true;
+    }
+    default: return false;
+  }
+}
+
+void ARM7TDMI::jit_compile(Block& block) {
+  const u32 size = block.state == THUMB_MODE ? 2 : 4;
+
+  block.native = nullptr;
+
+  // every translated instruction needs the 2 opcodes after it, a block cut short by the end of its page loses its tail
+  block.native_length = block.opcode_count < 2 ? 0 : static_cast<u8>(std::min<u32>(block.length, block.opcode_count - 2U));
+  if (block.native_length == 0) return;
+
+  jit.reserve_block();
+  block.native_epoch = jit.epoch;
+  u8* entry          = jit.cursor();
+
+  const i32 cpsr    = field(this, &regs.CPSR);
+  const i32 r15     = field(this, &regs.r[15]);
+  const i32 execute = field(this, &pipeline.execute);
+  const i32 decode  = field(this, &pipeline.decode);
+  const i32 fetch   = field(this, &pipeline.fetch);
+  const i32 flushed = field(this, &flushed_pipeline);
+
+  const u32 first_fetch  = block.start + (2 * size);
+  const u8* fetch_cycles = &bus->access_cycles[std::min<u32>(first_fetch >> 24, 0x10)][static_cast<u8>(size == 2 ? ACCESS_WIDTH::HALFWORD : ACCESS_WIDTH::WORD)]
+                                              [static_cast<u8>(ACCESS_TYPE::NON_SEQUENTIAL)];
+
+  jit.push(JIT::RBX);
+  jit.push(JIT::R12);
+  jit.push(JIT::R13);
+  jit.push(JIT::R14);
+  jit.alu64_imm8(JIT::SUB, JIT::RSP, 40);  // 16 byte aligned calls, and the shadow space win64 wants
+  jit.mov64(JIT::RBX, JIT::ARG0);
+  jit.mov64(JIT::R12, JIT::ARG1);
+  jit.mov64_imm(JIT::R13, reinterpret_cast<u64>(&cycles_elapsed));
+  jit.mov64_imm(JIT::R14, reinterpret_cast<u64>(fetch_cycles));
+
+  // what step() would have left in the pipeline and r15 around instruction i
+  auto sync = [&](u8 i, u32 pc) {
+    jit.store32_imm(JIT::RBX, execute, block.instrs[i].opcode);
+    jit.store32_imm(JIT::RBX, decode, block.instrs[i + 1].opcode);
+    jit.store32_imm(JIT::RBX, fetch, block.instrs[i + 2].opcode);
+    jit.store32_imm(JIT::RBX, r15, pc);
+  };
+
+  struct Exit {
+    u8* jump;
+    u8 executed;
+    bool sync;  // the handler already left everything in place if false
+  };
+  std::vector<Exit> exits;
+
+  for (u8 i = 0; i < block.native_length; i++) {
+    const CachedInstr& instr = block.instrs[i];
+    const u32 pc             = block.start + ((i + 2) * size);  // r15 while it executes, the address the pipeline fetches from
+
+    jit.load64(JIT::RCX, JIT::R13, 0);
+    jit.load8_zx(JIT::RAX, JIT::R14, 0);
+    jit.alu64(JIT::ADD, JIT::RCX, JIT::RAX);
+    jit.store64(JIT::R13, 0, JIT::RCX);
+
+    if (pc <= 0x3FFF) {
+      jit.mov64_imm(JIT::RAX, reinterpret_cast<u64>(&bus->bios_open_bus));
+      jit.store32_imm(JIT::RAX, 0, block.instrs[i + 2].opcode);
+    }
+
+    u8* skip = block.state == ARM_MODE && instr.cond != AL ? emit_condition_check(jit, cpsr, condition_masks[instr.cond]) : nullptr;
+
+    if (!jit_emit_instr(instr, block.state)) {
+      sync(i, pc);
+      jit.store8_imm(JIT::RBX, flushed, 0);
+
+      jit.mov64(JIT::ARG0, JIT::RBX);
+      jit.mov32_imm(JIT::ARG1, instr.opcode);
+      jit.call(reinterpret_cast<const void*>(instr.handler));
+
+      jit.mov64(JIT::ARG0, JIT::RBX);
+      jit.mov64_imm(JIT::ARG1, reinterpret_cast<u64>(&block));
+      jit.call(reinterpret_cast<const void*>(leave_after_handler));
+      jit.test32(JIT::RAX, JIT::RAX);
+      exits.push_back({.jump = jit.jcc(JIT::NE), .executed = static_cast<u8>(i + 1), .sync = false});
+    }
+
+    if (skip != nullptr) JIT::patch(skip, jit.cursor());
+
+    if (i + 1 == block.native_length) break;  // same thing as running off the end
+
+    jit.load64(JIT::RAX, JIT::R13, 0);
+    jit.alu64(JIT::CMP, JIT::RAX, JIT::R12);
+    exits.push_back({.jump = jit.jcc(JIT::AE), .executed = static_cast<u8>(i + 1), .sync = true});
+  }
+
+  sync(block.native_length - 1, block.start + ((block.native_length + 2) * size));
+  jit.mov32_imm(JIT::RAX, block.native_length);
+
+  u8* epilogue = jit.cursor();
+  jit.alu64_imm8(JIT::ADD, JIT::RSP, 40);
+  jit.pop(JIT::R14);
+  jit.pop(JIT::R13);
+  jit.pop(JIT::R12);
+  jit.pop(JIT::RBX);
+  jit.ret();
+
+  for (const Exit& exit : exits) {
+    JIT::patch(exit.jump, jit.cursor());
+    if (exit.sync) sync(exit.executed - 1, block.start + ((exit.executed + 2) * size));
+    jit.mov32_imm(JIT::RAX, exit.executed);
+    JIT::patch(jit.jmp(), epilogue);
+  }
+
+  block.native = reinterpret_cast<NativeBlock>(entry);
+}
+
+// Single instruction, no pipeline or cycle bookkeeping, nullptr if it would only call its handler.
+// Emitted fresh on every call, step_native() is the only user.
+NativeInstr ARM7TDMI::jit_compile_instr(u32 opcode) {
+  const CPU_MODE state = regs.CPSR.STATE_BIT;
+  const FuncPtr handler = state == THUMB_MODE ? thumb_funcs[(opcode >> 6) & 0x3FF] : arm_funcs[((opcode & 0xff00000) >> 16) | ((opcode & 0b11110000) >> 4)];
+
+  if (handler == nullptr) return nullptr;
+
+  const CachedInstr instr = {.handler = handler, .opcode = opcode, .cond = state == THUMB_MODE ? AL : static_cast<Condition>(opcode >> 28)};
+
+  jit.reserve_block();
+  u8* entry = jit.cursor();
+
+  jit.push(JIT::RBX);
+  jit.mov64(JIT::RBX, JIT::ARG0);
+
+  u8* skip = instr.cond != AL ? emit_condition_check(jit, field(this, &regs.CPSR), condition_masks[instr.cond]) : nullptr;
+
+  if (!jit_emit_instr(instr, state)) {
+    jit.offset = static_cast<size_t>(entry - jit.code);
+    return nullptr;
+  }
+
+  if (skip != nullptr) JIT::patch(skip, jit.cursor());
+
+  jit.pop(JIT::RBX);
+  jit.ret();
+
+  return reinterpret_cast<NativeInstr>(entry);
+}
+
+// Same contract as run_block(), 0 if the block isn't translated (yet) or can't be entered from the current state.
+u32 ARM7TDMI::run_native(Block& block, u64 target_cycle) {
+  if (!use_jit || !jit.available()) return 0;
+
+  if (block.native == nullptr || block.native_epoch != jit.epoch) {
+    if (++block.run_count < JIT_THRESHOLD) return 0;
+
+    block.run_count = 0;
+    jit_compile(block);
+    if (block.native == nullptr) return 0;
+  }
+
+  // translated code takes the first 2 opcodes for granted
+  if (pipeline.decode != block.instrs[0].opcode || pipeline.fetch != block.instrs[1].opcode) return 0;
+  if (irq_ready()) return 0;
+
+  regs.sync_flags();
+  u32 executed = block.native(this, target_cycle);
+  instructions_executed += executed;
+
+  return executed;
+}
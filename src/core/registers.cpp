@@ -4,10 +4,36 @@
 
 #include "spdlog/fmt/bundled/core.h"
 
+void Registers::materialize_flags() {
+  const u32 result = lazy_flags.result;
+  const u32 op1    = lazy_flags.op1;
+  const u32 op2    = lazy_flags.op2;
+
+  CPSR.SIGN_FLAG = result >> 31;
+  CPSR.ZERO_FLAG = result == 0;
+
+  switch (lazy_flags.op) {
+    case FLAG_OP::ADD: {
+      CPSR.CARRY_FLAG    = result < op1;
+      CPSR.OVERFLOW_FLAG = (~(op1 ^ op2) & (op1 ^ result)) >> 31;
+      break;
+    }
+    case FLAG_OP::SUB: {
+      CPSR.CARRY_FLAG    = op1 >= op2;
+      CPSR.OVERFLOW_FLAG = ((op1 ^ op2) & (op1 ^ result)) >> 31;
+      break;
+    }
+    default: break;
+  }
+
+  lazy_flags.op = FLAG_OP::NONE;
+}
+
 u32 Registers::get_spsr(BANK_MODE m) {
   switch (m) {
     case USER:
     case SYSTEM: {
+      sync_flags();
       // fmt::println("fetching spsr of SYSTEM/USER: {:#010x}", CPSR.value);
       return CPSR.value;
     }
@@ -51,64 +77,64 @@ std::string Registers::get_mode_string(BANK_MODE bm) {
   }
 }
 
-u32& Registers::get_reg(u8 i) {
-  assert(i < 16);
+static constexpr bool is_banked(BANK_MODE mode, u8 i) {
+  switch (mode) {
+    case USER:
+    case SYSTEM: return false;
+    case SUPERVISOR:
+    case ABORT:
+    case IRQ:
+    case UNDEFINED: return i >= 13;
+    default: return true;  // FIQ, and the invalid modes
+  }
+}
 
-  if (i < 8) {
-    return r[i];
+u32* Registers::bank(BANK_MODE mode) {
+  switch (mode) {
+    case USER:
+    case SYSTEM: return usr_r;
+    case FIQ: return fiq_r;
+    case SUPERVISOR: return svc_r;
+    case ABORT: return abt_r;
+    case IRQ: return irq_r;
+    case UNDEFINED: return und_r;
+    default: return inv_r;
   }
+}
 
+void Registers::switch_bank(BANK_MODE from, BANK_MODE to) {
+  from = static_cast<BANK_MODE>(from | 0x10);
+  to   = static_cast<BANK_MODE>(to | 0x10);
 
-  switch ((CPSR.MODE_BIT | 0x10)) {
-    case USER:
-    case SYSTEM: {
-      return r[i];
-    }
-    case FIQ: {
-      if (i > 7 && i < 15) {
-        return fiq_r[i];
-      }
-      return r[i];
-    }
-    case SUPERVISOR: {
-      if ((i < 13) || (i == 15)) {
-        return r[i];
-      }
-      return svc_r[i];
-    }
-    case ABORT: {
-      if ((i < 13) || (i == 15)) {
-        return r[i];
-      }
-      return abt_r[i];
-    }
-    case IRQ: {
-      if ((i < 13) || (i == 15)) {
-        return r[i];
-      }
-      return irq_r[i];
-    }
-    case UNDEFINED: {
-      if ((i < 13) || (i == 15)) {
-        return r[i];
-      }
-      return und_r[i];
-    }
-    default: {
-      if (i > 7 && i < 15) {
-        return zero;
-      }
-      return r[i];
-    }
+  if (bank(from) == bank(to)) return;
+
+  u32* from_bank = bank(from);
+  u32* to_bank   = bank(to);
+
+  for (u8 i = 8; i < 15; i++) {
+    (is_banked(from, i) ? from_bank : usr_r)[i] = r[i];
+  }
+  for (u8 i = 8; i < 15; i++) {
+    r[i] = (is_banked(to, i) ? to_bank : usr_r)[i];
   }
+}
+
+u32& Registers::user_reg(u8 i) {
+  assert(i < 16);
 
-  assert(0);
+  if (i >= 8 && i < 15 && is_banked(static_cast<BANK_MODE>(CPSR.MODE_BIT | 0x10), i)) return usr_r[i];
+
+  return r[i];
 }
 
 // When we load a SPSR, we should first copy registers, then copy the actual
 // SPSR value into CPSR (get mode bits from SPSR, then copy)
 
 void Registers::load_spsr_to_cpsr() {
+  sync_flags();  // USER and SYSTEM keep CPSR as is
+
+  const BANK_MODE old_mode = CPSR.MODE_BIT;
+
   switch (CPSR.MODE_BIT) {
     case USER:
     case SYSTEM: {
@@ -138,4 +164,6 @@ void Registers::load_spsr_to_cpsr() {
       assert(0);
     }
   }
-}
\ No newline at end of file
+
+  switch_bank(old_mode, CPSR.MODE_BIT);
+}
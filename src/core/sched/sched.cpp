@@ -1,83 +1,177 @@
 #include "sched/sched.hpp"
 
+#include <algorithm>
+
 #include "agb.hpp"
 #include "bus.hpp"
 #include "common/stopwatch.hpp"
 
-void Scheduler::schedule(EventType e, u64 when) { event_queue.push({e, when}); }
+void Scheduler::swap_slots(u8 a, u8 b) {
+  std::swap(heap[a], heap[b]);
+  position[static_cast<u8>(heap[a].type)] = a;
+  position[static_cast<u8>(heap[b].type)] = b;
+}
+
+void Scheduler::sift_up(u8 idx) {
+  while (idx > 0) {
+    u8 parent = static_cast<u8>((idx - 1) / 2);
+    if (heap[parent].timestamp <= heap[idx].timestamp) break;
+    swap_slots(parent, idx);
+    idx = parent;
+  }
+}
+
+void Scheduler::sift_down(u8 idx) {
+  while (true) {
+    u8 smallest = idx;
+    u8 left     = static_cast<u8>((2 * idx) + 1);
+    u8 right    = static_cast<u8>((2 * idx) + 2);
+
+    if (left < size && heap[left].timestamp < heap[smallest].timestamp) smallest = left;
+    if (right < size && heap[right].timestamp < heap[smallest].timestamp) smallest = right;
+    if (smallest == idx) break;
+
+    swap_slots(smallest, idx);
+    idx = smallest;
+  }
+}
+
+void Scheduler::remove_at(u8 idx) {
+  position[static_cast<u8>(heap[idx].type)] = NOT_SCHEDULED;
+  size--;
+
+  if (idx != size) {
+    heap[idx]                                 = heap[size];
+    position[static_cast<u8>(heap[idx].type)] = idx;
+    sift_down(idx);
+    sift_up(idx);
+  }
+
+  next_event_timestamp = empty() ? NO_EVENT : heap[0].timestamp;
+}
+
+void Scheduler::schedule(EventType e, u64 when) {
+  u8& idx = position[static_cast<u8>(e)];
+
+  if (when < next_event_timestamp) preempted = true;
+
+  if (idx == NOT_SCHEDULED) {  // new event
+    idx       = size++;
+    heap[idx] = {e, when};
+    sift_up(idx);
+  } else {  // already pending, move it
+    heap[idx].timestamp = when;
+    sift_down(idx);
+    sift_up(idx);
+  }
+
+  next_event_timestamp = heap[0].timestamp;
+}
 
-i64 Scheduler::get_diff_adjusted_timestamp(const Event& e, const u64 current_timestamp, const u64 target_timestamp) {
+void Scheduler::cancel(EventType e) {
+  u8 idx = position[static_cast<u8>(e)];
+  if (idx == NOT_SCHEDULED) return;
+
+  remove_at(idx);
+}
+
+u64 Scheduler::get_diff_adjusted_timestamp(const Event& e, const u64 current_timestamp, const u64 target_timestamp) {
   return (current_timestamp + (e.timestamp - current_timestamp) + target_timestamp);
 }
-void Scheduler::step(AGB& agb, u32 cycles) {
-  cycles_elapsed += cycles;
-  while (cycles_elapsed >= event_queue.top().timestamp) {
-    const Event& event = event_queue.top();
+
+void Scheduler::process_events(AGB& agb) {
+  while (!empty() && cycles_elapsed >= heap[0].timestamp) {
+    const Event event = heap[0];
+    remove_at(0);
+
     switch (event.type) {
       case EventType::VBLANK: {
-        agb.bus.display_fields.DISPSTAT.set_vblank();
+        agb.ppu.display_fields.DISPSTAT.set_vblank();
         agb.ppu.db.swap_buffers();
-        agb.ppu.reset_sprite_layer();
         Stopwatch::end();
         Stopwatch::start();
 
-        if (agb.bus.display_fields.DISPSTAT.VBLANK_IRQ_ENABLE) {
+        if (agb.ppu.display_fields.DISPSTAT.VBLANK_IRQ_ENABLE) {
           agb.bus.request_interrupt(INTERRUPT_TYPE::LCD_VBLANK);
         }
+        agb.trigger_dma(DMA_START_TIMING::VBLANK);
 
         schedule(EventType::VBLANK, get_diff_adjusted_timestamp(event, cycles_elapsed, 197120));
         break;
       }
       case EventType::HBLANK_START: {
-        agb.bus.display_fields.DISPSTAT.set_hblank();
+        agb.ppu.display_fields.DISPSTAT.set_hblank();
 
-        if (agb.bus.display_fields.DISPSTAT.HBLANK_IRQ_ENABLE) {
+        if (agb.ppu.display_fields.DISPSTAT.HBLANK_IRQ_ENABLE) {
           agb.bus.request_interrupt(INTERRUPT_TYPE::LCD_HBLANK);
         }
+        if (agb.ppu.display_fields.VCOUNT.LY < 160) agb.trigger_dma(DMA_START_TIMING::HBLANK);  // no hblank dma during vblank
         schedule(EventType::HBLANK_END, get_diff_adjusted_timestamp(event, cycles_elapsed, 226));
         break;
       }
       case EventType::HBLANK_END: {
-        agb.bus.display_fields.DISPSTAT.reset_hblank();
+        agb.ppu.display_fields.DISPSTAT.reset_hblank();
         agb.ppu.step();
-        if (agb.bus.display_fields.VCOUNT.LY == 227) {
-          agb.bus.display_fields.VCOUNT.LY = 0;
+        if (agb.ppu.display_fields.VCOUNT.LY == 227) {
+          agb.ppu.display_fields.VCOUNT.LY = 0;
         } else {
-          agb.bus.display_fields.VCOUNT.LY++;
-          if (agb.bus.display_fields.VCOUNT.LY == 227) {
-            agb.bus.display_fields.DISPSTAT.reset_vblank();
+          agb.ppu.display_fields.VCOUNT.LY++;
+          if (agb.ppu.display_fields.VCOUNT.LY == 227) {
+            agb.ppu.display_fields.DISPSTAT.reset_vblank();
           }
         }
 
-        if (agb.bus.display_fields.VCOUNT.LY == agb.bus.display_fields.DISPSTAT.LYC) {
-          agb.bus.display_fields.DISPSTAT.VCOUNT_MATCH_FLAG = true;
+        if (agb.ppu.display_fields.VCOUNT.LY == agb.ppu.display_fields.DISPSTAT.LYC) {
+          agb.ppu.display_fields.DISPSTAT.VCOUNT_MATCH_FLAG = true;
 
-          if (agb.bus.display_fields.DISPSTAT.V_COUNTER_IRQ_ENABLE) {
+          if (agb.ppu.display_fields.DISPSTAT.V_COUNTER_IRQ_ENABLE) {
             agb.bus.request_interrupt(INTERRUPT_TYPE::LCD_VCOUNT_MATCH);
           }
 
         } else {
-          agb.bus.display_fields.DISPSTAT.VCOUNT_MATCH_FLAG = false;
+          agb.ppu.display_fields.DISPSTAT.VCOUNT_MATCH_FLAG = false;
         }
 
         schedule(EventType::HBLANK_START, get_diff_adjusted_timestamp(event, cycles_elapsed, 1232));
         break;
       }
-      case EventType::TIMER0_START: {
-        agb.timers[0].ctrl.timer_irq_enable = true;
-        agb.timers[0].counter               = agb.timers[0].reload_value;
-        // agb.timers
+      case EventType::TIMER0_OVERFLOW:
+      case EventType::TIMER1_OVERFLOW:
+      case EventType::TIMER2_OVERFLOW:
+      case EventType::TIMER3_OVERFLOW: {
+        agb.timers[static_cast<u8>(event.type) - static_cast<u8>(EventType::TIMER0_OVERFLOW)].overflow(event.timestamp);
         break;
       }
+      case EventType::COUNT: assert(0);
     }
+  }
 
-    event_queue.pop();
+  if (cycles_elapsed >= REBASE_THRESHOLD) rebase(agb);
+}
+
+// Moves the time origin forward so cycles_elapsed stays small. Everything holding an absolute
+// timestamp is shifted by the same amount, so relative distances are unchanged.
+void Scheduler::rebase(AGB& agb) {
+  u64 base = cycles_elapsed;
+
+  for (const Timer& t : agb.timers) {
+    if (t.ctrl.timer_start_stop) base = std::min(base, t.start_time);
+  }
+
+  cycles_elapsed -= base;
+
+  for (u8 i = 0; i < size; i++) {
+    heap[i].timestamp -= base;
+  }
+  next_event_timestamp = empty() ? NO_EVENT : heap[0].timestamp;
+
+  for (Timer& t : agb.timers) {
+    t.rebase(base);
   }
 }
 
-void Scheduler::print_scheduled_events() {
-  while (!event_queue.empty()) {
-    fmt::println("timestamp: {}", event_queue.top().timestamp);
-    event_queue.pop();
+void Scheduler::print_scheduled_events() const {
+  for (u8 i = 0; i < size; i++) {
+    fmt::println("type: {} timestamp: {}", static_cast<u8>(heap[i].type), heap[i].timestamp);
   }
-}
\ No newline at end of file
+}
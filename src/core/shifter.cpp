@@ -117,7 +117,7 @@ u32 ARM7TDMI::shift(SHIFT_MODE mode, u64 value, u64 amount, bool special, bool n
 
         r &= ~(1 << 31);
 
-        r |= (regs.CPSR.CARRY_FLAG << 31);
+        r |= (get_carry() << 31);
 
         if (affect_flags) { (value & 1) == 1 ? set_carry() : reset_carry(); }
         return r;
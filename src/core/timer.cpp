@@ -1,7 +1,9 @@
 #include "timer.hpp"
 
 #include "bus.hpp"
+#include "common/bytes.hpp"
 #include "enums.hpp"
+#include "sched/sched.hpp"
 #include "spdlog/fmt/bundled/base.h"
 
 static u8 timer_id = 0;
@@ -12,28 +14,88 @@ Timer::Timer() {
   ctrl.prescaler = F_1;
   fmt::println("created timer {}", id);
 }
-void Timer::reload_counter() { counter = reload_value; }
 
-void Timer::tick(u64 cycles) {
+bool Timer::is_cascading() const { return id != 0 && ctrl.count_up_timing; }
+
+u16 Timer::get_counter() const {
+  if (!ctrl.timer_start_stop || is_cascading()) return counter;
+  if (cycles_elapsed <= start_time) return start_value;
+
+  u64 ticks = (cycles_elapsed - start_time) / get_divider_val();
+  u64 span  = 0x10000 - start_value;
+
+  // the overflow event may not have been processed yet, wrap around the reload value like hardware would
+  if (ticks >= span) return static_cast<u16>(reload_value + ((ticks - span) % (0x10000 - reload_value)));
+
+  return static_cast<u16>(start_value + ticks);
+}
+
+void Timer::schedule_overflow() {
+  if (!ctrl.timer_start_stop || is_cascading()) return;
+
+  overflow_timestamp = start_time + ((0x10000 - start_value) * get_divider_val());
+
+  bus->scheduler->schedule(get_overflow_event(), overflow_timestamp);
+}
+
+void Timer::write_control(u8 byte, u8 value) {
+  bool was_running = ctrl.timer_start_stop;
+
+  counter = get_counter();  // latch before the prescaler/cascade settings change
+  set_byte(ctrl.v, byte, value);
+
+  bus->scheduler->cancel(get_overflow_event());
+  overflow_timestamp = 0;
+
   if (!ctrl.timer_start_stop) return;
-  // fmt::println("delta: {} -- cycle request: {}", (cycles_elapsed - (start_time + 2)), cycles);
 
-  if (!(start_time < cycles_elapsed)) {
-    // fmt::println("calculated delta: {}, start time: {}, cycles_elapsed: {}, cycles requested: {}", (start_time) - cycles_elapsed, start_time, cycles_elapsed, cycles);
-    return;
+  if (!was_running) {  // Timer goes from OFF TO ON (0->1)
+    counter    = reload_value;
+    start_time = cycles_elapsed + 2;
+  } else {
+    start_time = cycles_elapsed;
   }
 
-  for (u64 i = 0; i < cycles; i++) {
-    if (((cycles_elapsed + cycles) % get_divider_val()) == 0) {
-      if (counter == 0xFFFF) {
-        counter = reload_value;
-        if (ctrl.timer_irq_enable) bus->request_interrupt(get_timer_interrupt());
+  start_value = counter;
+  schedule_overflow();
+}
+
+void Timer::overflow(u64 timestamp) {
+  counter = reload_value;
 
-      } else {
-        counter++;
-      }
-    }
+  if (ctrl.timer_irq_enable) bus->request_interrupt(get_timer_interrupt());
+
+  if (!is_cascading()) {
+    start_time  = timestamp;
+    start_value = reload_value;
+    schedule_overflow();
   }
+
+  if (next && next->ctrl.timer_start_stop && next->is_cascading()) next->count_up(timestamp);
+}
+
+void Timer::count_up(u64 timestamp) {
+  if (counter == 0xFFFF) {
+    overflow(timestamp);
+  } else {
+    counter++;
+  }
+}
+
+void Timer::rebase(u64 base) {
+  start_time         = start_time >= base ? start_time - base : 0;
+  overflow_timestamp = overflow_timestamp >= base ? overflow_timestamp - base : 0;
+}
+
+EventType Timer::get_overflow_event() const {
+  switch (id) {
+    case 0: return EventType::TIMER0_OVERFLOW;
+    case 1: return EventType::TIMER1_OVERFLOW;
+    case 2: return EventType::TIMER2_OVERFLOW;
+    case 3: return EventType::TIMER3_OVERFLOW;
+  };
+
+  throw std::runtime_error("bad id");
 }
 
 INTERRUPT_TYPE Timer::get_timer_interrupt() const {
@@ -67,4 +129,4 @@ u16 Timer::get_divider_val() const {
     case F_1024: return 1024;
     default: assert(0);
   }
-}
\ No newline at end of file
+}
@@ -187,7 +187,7 @@ void Frontend::show_timer_window() {
 
   ImGui::Text("Ticking Enabled: %d", agb->timers[0].ctrl.timer_start_stop);
   ImGui::Text("IRQ Enabled: %d", agb->timers[0].ctrl.timer_irq_enable);
-  ImGui::Text("Counter: %d", agb->timers[0].counter);
+  ImGui::Text("Counter: %d", agb->timers[0].get_counter());
   ImGui::Text("Prescaler: %s", agb->timers[0].get_prescaler_string().c_str());
 
   // =========================
@@ -196,7 +196,7 @@ void Frontend::show_timer_window() {
 
   ImGui::Text("Ticking Enabled: %d", agb->timers[1].ctrl.timer_start_stop);
   ImGui::Text("IRQ Enabled: %d", agb->timers[1].ctrl.timer_irq_enable);
-  ImGui::Text("Counter: %d", agb->timers[1].counter);
+  ImGui::Text("Counter: %d", agb->timers[1].get_counter());
   ImGui::Text("Prescaler: %s", agb->timers[1].get_prescaler_string().c_str());
 
   // =========================
@@ -206,7 +206,7 @@ void Frontend::show_timer_window() {
 
   ImGui::Checkbox("Ticking Enabled##l2", &enabled_2);
   ImGui::Checkbox("IRQ Enabled##il2", &irq_enabled_2);
-  ImGui::Text("Counter: %d", agb->timers[2].counter);
+  ImGui::Text("Counter: %d", agb->timers[2].get_counter());
   ImGui::Text("Prescaler: %s", agb->timers[2].get_prescaler_string().c_str());
 
   // =========================
@@ -217,7 +217,7 @@ void Frontend::show_timer_window() {
   ImGui::Checkbox("Ticking Enabled##l3", &enabled_3);
   ImGui::Checkbox("IRQ Enabled##il3", &irq_enabled_3);
 
-  ImGui::Text("Counter: %d", agb->timers[3].counter);
+  ImGui::Text("Counter: %d", agb->timers[3].get_counter());
   ImGui::Text("Prescaler: %s", agb->timers[3].get_prescaler_string().c_str());
 
   ImGui::End();
@@ -289,6 +289,9 @@ void Frontend::show_backgrounds() {
     case 1:
     case 2:
     case 3: {
+      // the PPU only renders the visible span of each line, the full map gets drawn here on demand
+      agb->ppu.render_text_bg_texture(static_cast<u8>(SelectedItem));
+      SDL_UpdateTexture(state.background_textures[SelectedItem], nullptr, agb->ppu.tile_map_texture_buffer_arr[SelectedItem].data(), 512 * 4);
       ImGui::Image(state.background_textures[SelectedItem], {512, 512});
       break;
     }
@@ -347,6 +350,7 @@ void Frontend::show_cpu_info() {
   ImGui::Text("CPU MODE: %s", agb->cpu.regs.CPSR.STATE_BIT ? "THUMB" : "ARM");
   ImGui::Text("OPERATING MODE: %s", mode_map.at(agb->cpu.regs.CPSR.MODE_BIT).c_str());
   ImGui::Text("CYCLES ELAPSED: %lu", cycles_elapsed);
+  ImGui::Text("IDLE CYCLES SKIPPED: %lu (%lu loops)", agb->cpu.idle_cycles_skipped, agb->cpu.idle_loops_skipped);
 
   ImGui::EndDisabled();
 
@@ -360,11 +364,13 @@ void Frontend::show_cpu_info() {
   ImGui::InputInt("step amount", &state.step_amount, 0, 0, 0);
   if (ImGui::Button("STEP")) {
     agb->cpu.step();
+    agb->cpu.regs.sync_flags();
   }
   if (ImGui::Button("STEP AMOUNT")) {
     for (int i = 0; i < state.step_amount; i++) {
       agb->cpu.step();
     }
+    agb->cpu.regs.sync_flags();
   }
 
   ImGui::Separator();
@@ -647,10 +653,6 @@ void Frontend::render_frame() {
   SDL_SetRenderTarget(renderer, NULL);
   SDL_RenderClear(renderer);
 
-  SDL_UpdateTexture(state.background_textures[0], nullptr, agb->ppu.tile_map_texture_buffer_arr[0].data(), 512 * 4);
-  SDL_UpdateTexture(state.background_textures[1], nullptr, agb->ppu.tile_map_texture_buffer_arr[1].data(), 512 * 4);
-  SDL_UpdateTexture(state.background_textures[2], nullptr, agb->ppu.tile_map_texture_buffer_arr[2].data(), 512 * 4);
-  SDL_UpdateTexture(state.background_textures[3], nullptr, agb->ppu.tile_map_texture_buffer_arr[3].data(), 512 * 4);
   SDL_UpdateTexture(state.background_affine_textures[0], nullptr, agb->ppu.tile_map_affine_texture_buffer_arr[0].data(), 1024 * 4);
   SDL_UpdateTexture(state.background_affine_textures[1], nullptr, agb->ppu.tile_map_affine_texture_buffer_arr[1].data(), 1024 * 4);
   SDL_UpdateTexture(state.background_affine_textures[2], nullptr, agb->ppu.tile_map_affine_texture_buffer_arr[2].data(), 1024 * 4);
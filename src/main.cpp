@@ -1,29 +1,226 @@
+#include <chrono>
 #include <format>
+#include <random>
 #include "frontend/window.hpp"
 #include "agb.hpp"
 #include "bus.hpp"
 #include "cli11/CLI11.hpp"
 #include "common.hpp"
+#include "common/color_conversion.hpp"
+#include "compositor.hpp"
 
 
-int handle_args(int& argc, char** argv, std::string& filename) {
+struct Options {
+  std::string filename = {};
+  u32 bench_frames     = 0;
+  bool no_block_cache  = false;
+  bool jit             = false;
+  bool no_idle_skip    = false;
+  bool hle_bios        = false;
+  bool hle_check       = false;
+  bool bios_boot       = false;
+  bool microbench      = false;
+};
+
+int handle_args(int& argc, char** argv, Options& options) {
   CLI::App app{"", "bass"};
-  app.add_option("-f,--file", filename, "path to ROM")->required();
+  app.add_option("-f,--file", options.filename, "path to ROM");
+  app.add_flag("--microbench", options.microbench, "time the ARM and THUMB interpreter loops and the line compositors on synthetic input, no ROM needed");
+  app.add_option("--bench", options.bench_frames, "run N frames headless and report instructions per second");
+  app.add_flag("--no-block-cache", options.no_block_cache, "interpret every instruction through step()");
+  app.add_flag("--jit", options.jit, "translate hot blocks to x86-64, needs the block cache");
+  app.add_flag("--no-idle-skip", options.no_idle_skip, "run busy-wait loops instead of skipping to the next event");
+  app.add_flag("--hle-bios", options.hle_bios, "service the common BIOS calls natively instead of running the BIOS");
+  app.add_flag("--bios-boot", options.bios_boot, "run the BIOS intro instead of starting the cartridge directly");
+  app.add_flag("--hle-check", options.hle_check, "run the BIOS for every call --hle-bios handles, and report where the HLE version differs");
 
   CLI11_PARSE(app, argc, argv);
   return 0;
 }
 
+// headless, nothing but the core, so the number reflects the cpu/bus path
+void run_benchmark(AGB& agb, u32 frames) {
+  static constexpr u64 CYCLES_PER_FRAME = 280896;
+
+  agb.schedule_ppu_events();
+
+  auto start = std::chrono::steady_clock::now();
+  while (cycles_elapsed < frames * CYCLES_PER_FRAME) agb.run_slice();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  const char* backend = agb.cpu.use_jit ? "jit" : agb.cpu.use_block_cache ? "block cache" : "step()";
+
+  fmt::println("{}: {} frames, {} instructions in {:.3f}s -- {:.2f} MIPS, {:.1f} fps", backend, frames,
+               agb.cpu.instructions_executed, elapsed.count(), static_cast<double>(agb.cpu.instructions_executed) / elapsed.count() / 1e6, frames / elapsed.count());
+  fmt::println("idle loops: {} skipped, {} cycles ({:.1f}% of the run)", agb.cpu.idle_loops_skipped, agb.cpu.idle_cycles_skipped,
+               100.0 * static_cast<double>(agb.cpu.idle_cycles_skipped) / static_cast<double>(frames * CYCLES_PER_FRAME));
+  if (agb.cpu.use_hle_bios) fmt::println("hle bios: {} calls, {} mismatches", agb.cpu.hle_calls, agb.cpu.hle_mismatches);
+}
+
+// Five instruction ALU loop in IWRAM, interpreted one instruction at a time, so the number is the cost of
+// run_interpreter() itself: no wait states, no block cache, no events.
+void run_microbenchmark(AGB& agb, CPU_MODE state) {
+  static constexpr u64 CYCLES = 100'000'000;
+  static constexpr u32 BASE   = 0x03000000;
+
+  static constexpr std::array<u32, 5> arm_loop = {
+      0xE2800001,  // add r0, r0, #1
+      0xE0211000,  // eor r1, r1, r0
+      0xE1A02081,  // mov r2, r1, lsl #1
+      0xE3500000,  // cmp r0, #0
+      0xEAFFFFFA,  // b BASE
+  };
+  static constexpr std::array<u16, 5> thumb_loop = {
+      0x3001,  // add r0, #1
+      0x4048,  // eor r0, r1
+      0x0042,  // lsl r2, r0, #1
+      0x2800,  // cmp r0, #0
+      0xE7FA,  // b BASE
+  };
+
+  for (u32 i = 0; i < 5; i++) {
+    if (state == THUMB_MODE) {
+      agb.bus.write16(BASE + (i * 2), thumb_loop[i]);
+    } else {
+      agb.bus.write32(BASE + (i * 4), arm_loop[i]);
+    }
+  }
+
+  agb.cpu.use_block_cache     = false;
+  agb.cpu.regs                = {};
+  agb.cpu.regs.CPSR.STATE_BIT = state;
+  agb.cpu.regs.r[15]          = BASE;
+  agb.cpu.flush_pipeline();
+  agb.cpu.regs.r[15] += state == THUMB_MODE ? 2 : 4;
+
+  const u64 instructions = agb.cpu.instructions_executed;
+  const u64 start_cycle  = cycles_elapsed;
+
+  auto start = std::chrono::steady_clock::now();
+  agb.cpu.run_until(start_cycle + CYCLES);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  const u64 executed = agb.cpu.instructions_executed - instructions;
+  fmt::println("{} loop: {} instructions in {:.3f}s -- {:.2f} MIPS, {:.2f} ns/instruction", state == THUMB_MODE ? "THUMB" : "ARM", executed,
+               elapsed.count(), static_cast<double>(executed) / elapsed.count() / 1e6, elapsed.count() * 1e9 / static_cast<double>(executed));
+}
+
+// Random lines with all five layers on, through every compositor and blend kernel the host has. Whether they
+// give the right result is checked by tests/compositor_tests.cpp, this only times them.
+void run_compose_benchmark() {
+  static constexpr u32 LINES  = 64;
+  static constexpr u32 ROUNDS = 20'000;
+
+  static constexpr std::array<u8, 5> ids = {LAYER_BG0, LAYER_BG1, LAYER_BG2, LAYER_BG3, LAYER_OBJ};
+
+  std::mt19937 rng(0xBA55);
+  std::vector<LayerLines> lines(LINES);
+  std::vector<std::array<u8, LINE_WIDTH>> effects(LINES);
+
+  // the faded palette entries don't have to be right to take the same time
+  std::array<u32, 512> brighter = {};
+  std::array<u32, 512> darker   = {};
+  for (u32 e = 0; e < brighter.size(); e++) {
+    brighter[e] = static_cast<u32>(rng()) & 0xFFFFFF;
+    darker[e]   = static_cast<u32>(rng()) & 0xFFFFFF;
+  }
+
+  for (u32 i = 0; i < LINES; i++) {
+    for (auto& layer : lines[i]) {
+      for (u32 x = 0; x < LINE_WIDTH; x++) {
+        layer.color[x]  = i % 8 ? static_cast<u32>(rng()) & 0x1FF7FFF : DIRECT_COLOR | (static_cast<u32>(rng()) & 0x7FFF);  // every 8th a bitmap line
+        layer.prio[x]   = static_cast<u8>(rng() % 4);
+        layer.opaque[x] = rng() % 3 ? 0xFF : 0;
+      }
+    }
+
+    for (auto& effect : effects[i]) effect = static_cast<u8>(rng() % 4);
+  }
+
+  // coefficients of line i, in the 0-16 range the PPU clamps them to
+  auto eva = [](u32 i) { return i % 17; };
+  auto evb = [](u32 i) { return 16 - (i % 17); };
+  auto tables = [&](u32 i) { return BlendTables{.rgb = BGR555_TO_RGB888_LUT.data(), .brighter = brighter.data(), .darker = darker.data(), .evy = (i * 7) % 17}; };
+
+  std::vector<CompositeLine> composed(LINES);
+  for (u32 i = 0; i < LINES; i++) get_composite_kernel(COMPOSITOR::SCALAR)(lines[i], ids.data(), ids.size(), 0x7F7F7F, composed[i]);
+
+  for (COMPOSITOR c : {COMPOSITOR::SCALAR, COMPOSITOR::SSE41, COMPOSITOR::AVX2}) {
+    if (!compositor_supported(c)) {
+      fmt::println("{} compositor: not supported here", compositor_name(c));
+      continue;
+    }
+
+    const CompositeKernel kernel        = get_composite_kernel(c);
+    const BlendKernel blend             = get_blend_kernel(c);
+    CompositeLine out                   = {};
+    std::array<u32, LINE_WIDTH> blended = {};
+
+    u32 sink   = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (u32 round = 0; round < ROUNDS; round++) {
+      kernel(lines[round % LINES], ids.data(), ids.size(), 0x7F7F7F, out);
+      sink += out.top_color[round % LINE_WIDTH];
+    }
+    std::chrono::duration<double> composite_time = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (u32 round = 0; round < ROUNDS; round++) {
+      const u32 i = round % LINES;
+      blend(composed[i], effects[i].data(), tables(i), eva(i), evb(i), blended.data());
+      sink += blended[round % LINE_WIDTH];
+    }
+    std::chrono::duration<double> blend_time = std::chrono::steady_clock::now() - start;
+
+    fmt::println("{} compositor: {:.1f} ns/line, blend {:.1f} ns/line (sink {:#x})", compositor_name(c), composite_time.count() * 1e9 / ROUNDS,
+                 blend_time.count() * 1e9 / ROUNDS, sink);
+  }
+}
+
 int main(int argc, char** argv) {
-  std::string filename = {};
-  handle_args(argc, argv, filename); 
+  Options options = {};
+  handle_args(argc, argv, options);
 
   // setup system thread
-  AGB agb = {};
+  AGB agb                 = {};
+  agb.cpu.use_block_cache = !options.no_block_cache;
+  agb.cpu.use_jit         = options.jit && !options.no_block_cache && agb.cpu.jit.available();
+  agb.cpu.use_idle_skip   = !options.no_idle_skip;
+  agb.cpu.use_hle_bios    = options.hle_bios || options.hle_check || !agb.bus.has_bios;
+  agb.cpu.check_hle_bios  = options.hle_check && agb.bus.has_bios;
+
+  if (options.microbench) {
+    run_microbenchmark(agb, ARM_MODE);
+    run_microbenchmark(agb, THUMB_MODE);
+    run_compose_benchmark();
+    return 0;
+  }
+
+  if (options.filename.empty()) {
+    fmt::println("a ROM is required (-f)");
+    return 1;
+  }
+
+  std::vector<u8> file = read_file(options.filename);
+
+  auto boot = [&] {
+    agb.bus.pak->load_data(file);
+    if (options.bios_boot && agb.bus.has_bios) {
+      agb.bios_boot();
+    } else {
+      agb.direct_boot();
+    }
+  };
+
+  if (options.bench_frames) {
+    boot();
+    run_benchmark(agb, options.bench_frames);
+    return 0;
+  }
+
   Frontend f{&agb};
 
-  std::vector<u8> file = read_file(filename);
-  agb.bus.pak->load_data(file);
+  boot();
   SDL_SetWindowTitle(f.window, std::format("bass | {}", agb.pak.info.game_title).c_str());
   
   std::thread system = std::thread(&AGB::system_loop, &agb);
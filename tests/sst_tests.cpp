@@ -18,6 +18,7 @@
 using json = nlohmann::json;
 
 static std::vector<std::string> completed            = {};
+static bool use_jit                                  = false;  // --jit, run the instructions through the recompiler
 static std::vector<std::string> multiplication_tests = {"arm_mul_mla.json", "arm_mull_mlal.json"};
 
 bool is_multiplication_test(const std::string& s) {
@@ -40,6 +41,7 @@ std::vector<std::string> list_files(const std::string& path) {
 
 void compare_states(AGB* b_ptr, Registers expected, bool is_multiplication_test) {
   Registers actual = b_ptr->cpu.regs;
+  actual.switch_bank(actual.CPSR.MODE_BIT, SYSTEM);  // every bank back in its own array, like the expected state
 
   for (const auto& transaction : b_ptr->bus.transactions) {
     if (transaction.kind == WRITE && !transaction.accessed) {
@@ -389,6 +391,7 @@ void get_cpu_from_state(const json& initial_json, AGB* bass) {
   bass->cpu.regs.SPSR_abt   = initial_json["initial"]["SPSR"][2];
   bass->cpu.regs.SPSR_irq   = initial_json["initial"]["SPSR"][3];
   bass->cpu.regs.SPSR_und   = initial_json["initial"]["SPSR"][4];
+  bass->cpu.regs.switch_bank(SYSTEM, bass->cpu.regs.CPSR.MODE_BIT);  // R holds the user registers
   fmt::println("INITIAL CPSR: {:#010X}", bass->cpu.regs.CPSR.value);
   fmt::println("N: {} Z: {} C: {} V: {} - mode: {} - sb: {}", +bass->cpu.regs.CPSR.SIGN_FLAG, +bass->cpu.regs.CPSR.ZERO_FLAG, +bass->cpu.regs.CPSR.CARRY_FLAG, +bass->cpu.regs.CPSR.OVERFLOW_FLAG,
                bass->cpu.regs.get_mode_string(bass->cpu.regs.CPSR.MODE_BIT), bass->cpu.regs.CPSR.STATE_BIT ? "THUMB" : "ARM");
@@ -469,7 +472,8 @@ void run_tests() {
       // fmt::println("{:#010B}", bass.cpu.pipeline.decode);
       // fmt::println("{}", bass.cpu.regs.CPSR.STATE_BIT == THUMB_MODE);
 
-      bass.cpu.step();
+      use_jit ? bass.cpu.step_native() : bass.cpu.step();
+      bass.cpu.regs.sync_flags();
       fmt::println("{}", test_file);
       // fmt::println("========= instruction params  =========");
       // bass.cpu.pipeline.execute.print_params();
@@ -483,7 +487,9 @@ void run_tests() {
   }
 };
 
-int main() {
+int main(int argc, char** argv) {
+  use_jit = argc > 1 && std::string(argv[1]) == "--jit";
+
   run_tests();
   for (const auto& test_file : completed) {
     fmt::println("{}", test_file);